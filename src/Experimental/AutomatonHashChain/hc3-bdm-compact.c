@@ -0,0 +1,241 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * This is an implementation of the HashChain algorithm, (currently unpublished) by Matt Palmer.
+ * It is a factor search similar to WFR or the QF family of algorithms.
+ *
+ * It builds a hash table containing entries for chains of hashes.  Hashes are chained together by
+ * placing a fingerprint of the *next* hash into the entry for the *current* hash.  This enables
+ * a check for the second hash value to be performed without requiring a second lookup in the hash table.
+ *
+ * It creates Q chains of hashes from the end of the pattern back to the start.
+ *
+ * The automaton version is a hybrid of HashChain and BDM.  Once a window has matched the whole chain, it is
+ * not verified with memcmp and shifted on by one.  Instead the window is read backwards through the suffix
+ * automaton of the reversed pattern, as BDM does.  This either confirms the match, or stops at the first byte which
+ * does not extend a factor of the pattern, and shifts the window to the longest prefix of the pattern it recognised.
+ * The compact version does not use the SIGMA wide int transition tables of AUTOMATON.h, which take 1KB per state.
+ * Bytes are mapped to classes, with one class for each distinct byte in the pattern, and one for all the others.
+ * Transitions are 16 bit state numbers in a table with a row of nclasses entries per state.  The automaton is built
+ * for the last FACTOR_SIZE bytes of the pattern at most, and the rest of the pattern is verified with memcmp.
+ *
+ * This implementation is written to integrate with the SMART string search benchmarking tool,
+ * by Simone Faro, Matt Palmer, Stefano Stefano Scafiti and Thierry Lecroq.
+*/
+
+#include "include/define.h"
+#include "include/main.h"
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#define ALPHA 11
+
+/*
+ * Number of bytes in a q-gram.
+ * Chain hash functions defined below must be written to process this number of bytes.
+ */
+#define	Q     3
+
+/*
+ * The maximum length of the suffix of the pattern the suffix automaton is built for.
+ * There can be up to twice as many states, which must fit in 16 bits.
+ */
+#define FACTOR_SIZE 4096
+
+/*
+ * Functions and calculated parameters.
+ * Hash functions must be written to use the number of bytes defined in Q. They scan backwards from the initial position.
+ */
+#define S                 ((ALPHA) / (Q))                          // Bit shift for each of the chain hash byte components.
+#define HASH(x, p, s)     ((((x[p] << (s)) + x[p - 1]) << (s)) + x[p - 2])  // General hash function using a bitshift for each byte added.
+#define CHAIN_HASH(x, p)  HASH((x), (p), (S))                      // Hash function for chain hashes, using the S bitshift.
+#define LINK_HASH(H)      (1U << ((H) & 0x1F))                     // Hash fingerprint, taking low 5 bits of the hash to set one of 32 bits.
+#define ASIZE             (1 << (ALPHA))                           // Hash table size.
+#define TABLE_MASK        ((ASIZE) - 1)                            // Mask for table is one less than the power of two size.
+#define Q2                (Q + Q)                                  // 2 Qs.
+#define END_FIRST_QGRAM   (Q - 1)                                  // Position of the end of the first q-gram.
+#define END_SECOND_QGRAM  (Q2 - 1)                                 // Position of the end of the second q-gram.
+
+/*
+ * Builds the hash table B of size ASIZE for a string x of length m.
+ * Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int preprocessing(const unsigned char *x, int m, unsigned int *B) {
+
+    // 0. Zero out the hash table.
+    for (int i = 0; i < ASIZE; i++) B[i] = 0;
+
+    // 1. Calculate all the chain hashes, ending with processing the entire pattern so H has the cumulative value.
+    unsigned int H;
+    int last_chain = m < Q2 ? m - END_FIRST_QGRAM : Q;
+    for (int chain_no = last_chain; chain_no >= 1; chain_no--)
+    {
+        H = CHAIN_HASH(x, m - chain_no);
+        for (int chain_pos = m - chain_no - Q; chain_pos >= END_FIRST_QGRAM; chain_pos -=Q)
+        {
+            unsigned int H_last = H;
+            H = CHAIN_HASH(x, chain_pos);
+            B[H_last & TABLE_MASK] |= LINK_HASH(H);
+        }
+    }
+
+    // 2. Add in hashes for the first qgrams that have no preceding value.  Only set a value if there is nothing there already.
+    unsigned int F;
+    int stop = MIN(m, END_SECOND_QGRAM);
+    for (int chain_pos = END_FIRST_QGRAM; chain_pos < stop; chain_pos++)
+    {
+        F = CHAIN_HASH(x, chain_pos);
+        if (!B[F & TABLE_MASK]) B[F & TABLE_MASK] = LINK_HASH(~F);
+    }
+
+    return H; // Return the hash value for processing the last q-gram.
+}
+
+/*
+ * Maps each byte to a class in classes, with one class for each distinct byte in x of length m,
+ * and class 0 for all bytes which do not appear in x, if there are any.  Returns the number of classes.
+ */
+int byte_classes(const unsigned char *x, int m, unsigned char *classes) {
+    int present[SIGMA] = {0};
+    for (int i = 0; i < m; i++) present[x[i]] = 1;
+    int distinct = 0;
+    for (int c = 0; c < SIGMA; c++) distinct += present[c];
+    int nclasses = distinct < SIGMA ? 1 : 0; // class 0 is for the absent bytes, if there are any.
+    for (int c = 0; c < SIGMA; c++) classes[c] = present[c] ? nclasses++ : 0;
+    return nclasses;
+}
+
+/*
+ * Builds the suffix automaton of the reverse of a string x of length m, using the byte classes.
+ * Transitions are stored in trans, with a row of nclasses state numbers per state, which must be zeroed first.
+ * No transition goes back to the initial state 0, so 0 means there is no transition.
+ * Terminal states are marked in terminal, which must also be zeroed.
+ */
+void build_compact_automaton(const unsigned char *x, int m, const unsigned char *classes, int nclasses,
+                             unsigned short *trans, unsigned char *terminal) {
+    int *length = (int *) malloc((2 * m + 1) * sizeof(int));
+    int *link = (int *) malloc((2 * m + 1) * sizeof(int));
+    int states = 1, last = 0;
+    length[0] = 0;
+    link[0] = -1;
+    for (int i = m - 1; i >= 0; i--) {
+        const int c = classes[x[i]];
+        const int state = states++;
+        length[state] = length[last] + 1;
+        int p = last;
+        while (p != -1 && !trans[p * nclasses + c]) {
+            trans[p * nclasses + c] = state;
+            p = link[p];
+        }
+        if (p == -1) {
+            link[state] = 0;
+        }
+        else {
+            const int q = trans[p * nclasses + c];
+            if (length[p] + 1 == length[q]) {
+                link[state] = q;
+            }
+            else {
+                // Split q by cloning it with the shorter length:
+                const int clone = states++;
+                memcpy(trans + clone * nclasses, trans + q * nclasses, nclasses * sizeof(unsigned short));
+                length[clone] = length[p] + 1;
+                link[clone] = link[q];
+                while (p != -1 && trans[p * nclasses + c] == q) {
+                    trans[p * nclasses + c] = clone;
+                    p = link[p];
+                }
+                link[q] = clone;
+                link[state] = clone;
+            }
+        }
+        last = state;
+    }
+    for (int p = last; p != -1; p = link[p]) terminal[p] = 1;
+    free(length);
+    free(link);
+}
+
+/*
+ * Searches for a pattern x of length m in a text y of length n and reports the number of occurrences found.
+ */
+int search(unsigned char *x, int m, unsigned char *y, int n) {
+    if (m < Q) return -1;  // have to be at least Q in length to search.
+    if (m > 4194304) return -1; // very large patterns will seg-fault.
+
+    unsigned int H, V, B[ASIZE];
+
+    /* Preprocessing */
+    BEGIN_PREPROCESSING
+    const int MQ1 = m - Q + 1;
+    preprocessing(x, m, B);
+
+    // Build the compact suffix automaton of the reverse of the last k bytes of the pattern.
+    const int k = MIN(m, FACTOR_SIZE);
+    const int prefix_len = m - k;
+    const int states = 2 * k + 1;
+    unsigned char classes[SIGMA];
+    const int nclasses = byte_classes(x + prefix_len, k, classes);
+    unsigned short *trans = (unsigned short *) calloc(states * nclasses, sizeof(unsigned short));
+    unsigned char *terminal = (unsigned char *) calloc(states, sizeof(unsigned char));
+    build_compact_automaton(x + prefix_len, k, classes, nclasses, trans, terminal);
+    END_PREPROCESSING
+
+    /* Searching */
+    BEGIN_SEARCHING
+    int count = 0;
+    int pos = m - 1;
+    // While within the search text:
+    while (pos < n) {
+
+        // If there is a bit set for the hash:
+        H = CHAIN_HASH(y, pos);
+        V = B[H & TABLE_MASK];
+        if (V) {
+
+            // Look at the chain of q-grams that precede it:
+            const int window_end_pos = pos;
+            const int end_second_qgram_pos = pos - m + Q2;
+            while (pos >= end_second_qgram_pos)
+            {
+                pos -= Q;
+                H = CHAIN_HASH(y, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & LINK_HASH(H))) goto shift;
+                V = B[H & TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - read the end of the window backwards through the
+            // automaton, remembering the position of the last prefix of the pattern recognised in window_shift:
+            const unsigned char *factor = y + window_end_pos - k + 1;
+            int state = 0, i = k - 1, window_shift = k, period = k;
+            while (i >= 0 && (state = trans[state * nclasses + classes[factor[i]]])) {
+                if (terminal[state]) {
+                    period = window_shift;
+                    window_shift = i;
+                }
+                i--;
+            }
+
+            // If we read the whole factor, verify any prefix of the pattern not in the automaton:
+            if (i < 0) {
+                if (memcmp(y + window_end_pos - m + 1, x, prefix_len) == 0) {
+                    (count)++;
+                }
+                window_shift = period;
+            }
+            pos = window_end_pos + window_shift;
+            continue;
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+    END_SEARCHING
+
+    free(trans);
+    free(terminal);
+    return count;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * This is an implementation of the HashChain algorithm, (currently unpublished) by Matt Palmer.
+ * It is a factor search similar to WFR or the QF family of algorithms.
+ *
+ * It builds a hash table containing entries for chains of hashes.  Hashes are chained together by
+ * placing a fingerprint of the *next* hash into the entry for the *current* hash.  This enables
+ * a check for the second hash value to be performed without requiring a second lookup in the hash table.
+ *
+ * It creates Q chains of hashes from the end of the pattern back to the start.
+ *
+ * The automaton version is a hybrid of HashChain and BDM.  Once a window has matched the whole chain, it is
+ * not verified with memcmp and shifted on by one.  Instead the window is read backwards through the suffix
+ * automaton of the reversed pattern, as BDM does.  This either confirms the match, or stops at the first byte which
+ * does not extend a factor of the pattern, and shifts the window to the longest prefix of the pattern it recognised.
+ * To keep the automaton small, it is built for the last FACTOR_SIZE bytes of the pattern at most, and the rest of
+ * the pattern is verified with memcmp if all of those are read.
+ *
+ * This implementation is written to integrate with the SMART string search benchmarking tool,
+ * by Simone Faro, Matt Palmer, Stefano Stefano Scafiti and Thierry Lecroq.
+*/
+
+#include "include/define.h"
+#include "include/main.h"
+#include "include/AUTOMATON.h"
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#define ALPHA 11
+
+/*
+ * Number of bytes in a q-gram.
+ * Chain hash functions defined below must be written to process this number of bytes.
+ */
+#define	Q     3
+
+/*
+ * The maximum length of the suffix of the pattern the suffix automaton is built for.
+ */
+#define FACTOR_SIZE 256
+
+/*
+ * Functions and calculated parameters.
+ * Hash functions must be written to use the number of bytes defined in Q. They scan backwards from the initial position.
+ */
+#define S                 ((ALPHA) / (Q))                          // Bit shift for each of the chain hash byte components.
+#define HASH(x, p, s)     ((((x[p] << (s)) + x[p - 1]) << (s)) + x[p - 2])  // General hash function using a bitshift for each byte added.
+#define CHAIN_HASH(x, p)  HASH((x), (p), (S))                      // Hash function for chain hashes, using the S bitshift.
+#define LINK_HASH(H)      (1U << ((H) & 0x1F))                     // Hash fingerprint, taking low 5 bits of the hash to set one of 32 bits.
+#define ASIZE             (1 << (ALPHA))                           // Hash table size.
+#define TABLE_MASK        ((ASIZE) - 1)                            // Mask for table is one less than the power of two size.
+#define Q2                (Q + Q)                                  // 2 Qs.
+#define END_FIRST_QGRAM   (Q - 1)                                  // Position of the end of the first q-gram.
+#define END_SECOND_QGRAM  (Q2 - 1)                                 // Position of the end of the second q-gram.
+
+/*
+ * Builds the hash table B of size ASIZE for a string x of length m.
+ * Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int preprocessing(const unsigned char *x, int m, unsigned int *B) {
+
+    // 0. Zero out the hash table.
+    for (int i = 0; i < ASIZE; i++) B[i] = 0;
+
+    // 1. Calculate all the chain hashes, ending with processing the entire pattern so H has the cumulative value.
+    unsigned int H;
+    int last_chain = m < Q2 ? m - END_FIRST_QGRAM : Q;
+    for (int chain_no = last_chain; chain_no >= 1; chain_no--)
+    {
+        H = CHAIN_HASH(x, m - chain_no);
+        for (int chain_pos = m - chain_no - Q; chain_pos >= END_FIRST_QGRAM; chain_pos -=Q)
+        {
+            unsigned int H_last = H;
+            H = CHAIN_HASH(x, chain_pos);
+            B[H_last & TABLE_MASK] |= LINK_HASH(H);
+        }
+    }
+
+    // 2. Add in hashes for the first qgrams that have no preceding value.  Only set a value if there is nothing there already.
+    unsigned int F;
+    int stop = MIN(m, END_SECOND_QGRAM);
+    for (int chain_pos = END_FIRST_QGRAM; chain_pos < stop; chain_pos++)
+    {
+        F = CHAIN_HASH(x, chain_pos);
+        if (!B[F & TABLE_MASK]) B[F & TABLE_MASK] = LINK_HASH(~F);
+    }
+
+    return H; // Return the hash value for processing the last q-gram.
+}
+
+/*
+ * Searches for a pattern x of length m in a text y of length n and reports the number of occurrences found.
+ */
+int search(unsigned char *x, int m, unsigned char *y, int n) {
+    if (m < Q) return -1;  // have to be at least Q in length to search.
+    if (m > 4194304) return -1; // very large patterns will seg-fault.
+
+    unsigned int H, V, B[ASIZE];
+
+    /* Preprocessing */
+    BEGIN_PREPROCESSING
+    const int MQ1 = m - Q + 1;
+    preprocessing(x, m, B);
+
+    // Build the suffix automaton of the reverse of the last k bytes of the pattern.
+    const int k = MIN(m, FACTOR_SIZE);
+    const int prefix_len = m - k;
+    const int states = 2 * k + 2;
+    int *ttrans = (int *) malloc(states * SIGMA * sizeof(int));
+    int *tlength = (int *) calloc(states, sizeof(int));
+    int *tsuffix = (int *) calloc(states, sizeof(int));
+    unsigned char *tterminal = (unsigned char *) calloc(states, sizeof(unsigned char));
+    memset(ttrans, UNDEFINED, states * SIGMA * sizeof(int));
+    unsigned char *xR = (unsigned char *) reverse((char *) x + prefix_len, k);
+    buildSimpleSuffixAutomaton(xR, k, ttrans, tlength, tsuffix, tterminal);
+    END_PREPROCESSING
+
+    /* Searching */
+    BEGIN_SEARCHING
+    int count = 0;
+    int pos = m - 1;
+    // While within the search text:
+    while (pos < n) {
+
+        // If there is a bit set for the hash:
+        H = CHAIN_HASH(y, pos);
+        V = B[H & TABLE_MASK];
+        if (V) {
+
+            // Look at the chain of q-grams that precede it:
+            const int window_end_pos = pos;
+            const int end_second_qgram_pos = pos - m + Q2;
+            while (pos >= end_second_qgram_pos)
+            {
+                pos -= Q;
+                H = CHAIN_HASH(y, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & LINK_HASH(H))) goto shift;
+                V = B[H & TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - read the end of the window backwards through the
+            // automaton, remembering the position of the last prefix of the pattern recognised in window_shift:
+            const unsigned char *factor = y + window_end_pos - k + 1;
+            int state = 0, i = k - 1, window_shift = k, period = k;
+            while (i >= 0 && getTarget(state, factor[i]) != UNDEFINED) {
+                state = getTarget(state, factor[i]);
+                if (isTerminal(state)) {
+                    period = window_shift;
+                    window_shift = i;
+                }
+                i--;
+            }
+
+            // If we read the whole factor, verify any prefix of the pattern not in the automaton:
+            if (i < 0) {
+                if (memcmp(y + window_end_pos - m + 1, x, prefix_len) == 0) {
+                    (count)++;
+                }
+                window_shift = period;
+            }
+            pos = window_end_pos + window_shift;
+            continue;
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+    END_SEARCHING
+
+    free(ttrans);
+    free(tlength);
+    free(tsuffix);
+    free(tterminal);
+    free(xR);
+    return count;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * This is an implementation of the HashChain algorithm, (currently unpublished) by Matt Palmer.
+ * It is a factor search similar to WFR or the QF family of algorithms.
+ *
+ * It builds a hash table containing entries for chains of hashes.  Hashes are chained together by
+ * placing a fingerprint of the *next* hash into the entry for the *current* hash.  This enables
+ * a check for the second hash value to be performed without requiring a second lookup in the hash table.
+ *
+ * The BNDM version is a bit-parallel hybrid of HashChain and BNDMq, for patterns with no more than 64 q-grams.
+ * Instead of chains, each table entry holds a 64 bit mask with a bit set for each position in the pattern at which
+ * a q-gram with that hash ends.  The search reads the q-grams of a window backwards, one byte apart, tracking all
+ * the alignments of the pattern which still match in a single word, so there is no separate chain walk or check of
+ * the hash of the first q-gram.  When the first q-gram of the pattern is recognised before the start of the window,
+ * the window can only be shifted as far as that position, as in BNDM.
+ *
+ * This implementation is written to integrate with the SMART string search benchmarking tool,
+ * by Simone Faro, Matt Palmer, Stefano Stefano Scafiti and Thierry Lecroq.
+*/
+
+#include "include/define.h"
+#include "include/main.h"
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#define ALPHA 11
+
+/*
+ * Number of bytes in a q-gram.
+ * Chain hash functions defined below must be written to process this number of bytes.
+ */
+#define	Q     2
+
+/*
+ * Functions and calculated parameters.
+ * Hash functions must be written to use the number of bytes defined in Q. They scan backwards from the initial position.
+ */
+#define S                 ((ALPHA) / (Q))                          // Bit shift for each of the chain hash byte components.
+#define HASH(x, p, s)     ((((x)[(p)]) << (s)) + ((x)[(p) - 1]))   // General hash function using a bitshift for each byte added.
+#define CHAIN_HASH(x, p)  HASH((x), (p), (S))                      // Hash function for chain hashes, using the S bitshift.
+#define ASIZE             (1 << (ALPHA))                           // Hash table size.
+#define TABLE_MASK        ((ASIZE) - 1)                            // Mask for table is one less than the power of two size.
+#define END_FIRST_QGRAM   (Q - 1)                                  // Position of the end of the first q-gram.
+#define MAX_QGRAMS        64                                       // Number of bits in the masks in the table.
+
+/*
+ * Builds the hash table B of size ASIZE for a string x of length m.
+ * Each entry has bit i set if the q-gram ending at position END_FIRST_QGRAM + i of x has that hash.
+ */
+void preprocessing(const unsigned char *x, int m, unsigned long long *B) {
+
+    // 0. Zero out the hash table.
+    for (int i = 0; i < ASIZE; i++) B[i] = 0;
+
+    // 1. Set the bit for the position of each q-gram in the entry for its hash.
+    for (int chain_pos = END_FIRST_QGRAM; chain_pos < m; chain_pos++)
+    {
+        B[CHAIN_HASH(x, chain_pos) & TABLE_MASK] |= 1ULL << (chain_pos - END_FIRST_QGRAM);
+    }
+}
+
+/*
+ * Searches for a pattern x of length m in a text y of length n and reports the number of occurrences found.
+ */
+int search(unsigned char *x, int m, unsigned char *y, int n) {
+    if (m < Q) return -1;  // have to be at least Q in length to search.
+    if (m - Q + 1 > MAX_QGRAMS) return -1; // the q-grams of the pattern must fit in the bits of a mask.
+
+    unsigned long long D, B[ASIZE];
+
+    /* Preprocessing */
+    BEGIN_PREPROCESSING
+    const int MQ1 = m - Q + 1;
+    preprocessing(x, m, B);
+    END_PREPROCESSING
+
+    /* Searching */
+    BEGIN_SEARCHING
+    int count = 0;
+    int pos = m - 1;
+    // While within the search text:
+    while (pos < n) {
+
+        // If any q-gram of the pattern has the hash of the q-gram at the end of the window:
+        D = B[CHAIN_HASH(y, pos) & TABLE_MASK];
+        if (D) {
+
+            // Read q-grams back from the end of the window while some alignment of the pattern still matches.
+            // Bit i of D is set if the q-grams read so far match the pattern, with the last one read ending at
+            // position END_FIRST_QGRAM + i of the pattern.
+            const int end_first_qgram_pos = pos - m + Q;
+            int shift = MQ1;
+            int qgram_pos = pos;
+            do {
+                // If the q-grams read so far are a prefix of the pattern:
+                if (D & 1) {
+                    // If we are back at the start of the window, verify the pattern:
+                    if (qgram_pos == end_first_qgram_pos) {
+                        if (memcmp(y + pos - m + 1, x, m) == 0) {
+                            (count)++;
+                        }
+                        break;
+                    }
+                    // Otherwise the pattern may start where the prefix starts, so the window can only shift that far:
+                    shift = qgram_pos - end_first_qgram_pos;
+                }
+                qgram_pos--;
+                D = (D >> 1) & B[CHAIN_HASH(y, qgram_pos) & TABLE_MASK];
+            } while (D);
+
+            // Shift the window to the start of the last prefix found, or past all the q-grams read.
+            pos += shift;
+            continue;
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        pos += MQ1;
+    }
+    END_SEARCHING
+
+    return count;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * This is an implementation of the HashChain algorithm, (currently unpublished) by Matt Palmer.
+ * It is a factor search similar to WFR or the QF family of algorithms.
+ *
+ * It builds a hash table containing entries for chains of hashes.  Hashes are chained together by
+ * placing a fingerprint of the *next* hash into the entry for the *current* hash.  This enables
+ * a check for the second hash value to be performed without requiring a second lookup in the hash table.
+ *
+ * It creates Q chains of hashes from the end of the pattern back to the start.
+ *
+ * The dispatch version compiles the search and verification kernels three times: for baseline x86-64,
+ * for SSE4.2 and for AVX2.  CPU features are detected once at startup and the best kernel is bound
+ * to a function pointer, so a single binary built without -march=native still uses the vector hardware
+ * it finds.  Setting the environment variable HASHCHAIN_KERNEL to "scalar", "sse42" or "avx2" forces
+ * a tier for testing, as long as the CPU supports it.
+ *
+ * This implementation is written to integrate with the SMART string search benchmarking tool,
+ * by Simone Faro, Matt Palmer, Stefano Stefano Scafiti and Thierry Lecroq.
+*/
+
+#include "include/define.h"
+#include "include/main.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86_KERNELS
+#endif
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#define ALPHA 12
+
+/*
+ * Number of bytes in a q-gram.
+ * Chain hash functions defined below must be written to process this number of bytes.
+ */
+#define	Q     4
+
+/*
+ * Functions and calculated parameters.
+ * Hash functions must be written to use the number of bytes defined in Q. They scan backwards from the initial position.
+ */
+#define S                 ((ALPHA) / (Q))                          // Bit shift for each of the chain hash byte components.
+#define HASH(x, p, s)     ((((((x[p] << (s)) + x[p - 1]) << (s)) + x[p - 2]) << (s)) + x[p - 3]) // General hash function using a bitshift for each byte added.
+#define CHAIN_HASH(x, p)  HASH((x), (p), (S))                      // Hash function for chain hashes, using the S bitshift.
+#define LINK_HASH(H)      (1U << ((H) & 0x1F))                     // Hash fingerprint, taking low 5 bits of the hash to set one of 32 bits.
+#define ASIZE             (1 << (ALPHA))                           // Hash table size.
+#define TABLE_MASK        ((ASIZE) - 1)                            // Mask for table is one less than the power of two size.
+#define Q2                (Q + Q)                                  // 2 Qs.
+#define END_FIRST_QGRAM   (Q - 1)                                  // Position of the end of the first q-gram.
+#define END_SECOND_QGRAM  (Q2 - 1)                                 // Position of the end of the second q-gram.
+
+/*
+ * Builds the hash table B of size ASIZE for a string x of length m.
+ * Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int preprocessing(const unsigned char *x, int m, unsigned int *B) {
+
+    // 0. Zero out the hash table.
+    for (int i = 0; i < ASIZE; i++) B[i] = 0;
+
+    // 1. Calculate all the chain hashes, ending with processing the entire pattern so H has the cumulative value.
+    unsigned int H;
+    int last_chain = m < Q2 ? m - END_FIRST_QGRAM : Q;
+    for (int chain_no = last_chain; chain_no >= 1; chain_no--)
+    {
+        H = CHAIN_HASH(x, m - chain_no);
+        for (int chain_pos = m - chain_no - Q; chain_pos >= END_FIRST_QGRAM; chain_pos -=Q)
+        {
+            unsigned int H_last = H;
+            H = CHAIN_HASH(x, chain_pos);
+            B[H_last & TABLE_MASK] |= LINK_HASH(H);
+        }
+    }
+
+    // 2. Add in hashes for the first qgrams that have no preceding value.  Only set a value if there is nothing there already.
+    unsigned int F;
+    int stop = MIN(m, END_SECOND_QGRAM);
+    for (int chain_pos = END_FIRST_QGRAM; chain_pos < stop; chain_pos++)
+    {
+        F = CHAIN_HASH(x, chain_pos);
+        if (!B[F & TABLE_MASK]) B[F & TABLE_MASK] = LINK_HASH(~F);
+    }
+
+    return H; // Return the hash value for processing the last q-gram.
+}
+
+/*
+ * Verification kernels.  Each returns true if the m bytes at a and b are identical.
+ */
+static inline int verify_scalar(const unsigned char *a, const unsigned char *b, int m) {
+    return memcmp(a, b, m) == 0;
+}
+
+#ifdef X86_KERNELS
+__attribute__((target("sse4.2")))
+static inline int verify_sse42(const unsigned char *a, const unsigned char *b, int m) {
+    int i = 0;
+    for (; i + 16 <= m; i += 16) {
+        __m128i diff = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (a + i)),
+                                     _mm_loadu_si128((const __m128i *) (b + i)));
+        if (!_mm_testz_si128(diff, diff)) return 0;
+    }
+    return memcmp(a + i, b + i, m - i) == 0;
+}
+
+__attribute__((target("avx2")))
+static inline int verify_avx2(const unsigned char *a, const unsigned char *b, int m) {
+    int i = 0;
+    for (; i + 32 <= m; i += 32) {
+        __m256i diff = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                        _mm256_loadu_si256((const __m256i *) (b + i)));
+        if (!_mm256_testz_si256(diff, diff)) return 0;
+    }
+    if (i + 16 <= m) {
+        __m128i diff = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (a + i)),
+                                     _mm_loadu_si128((const __m128i *) (b + i)));
+        if (!_mm_testz_si128(diff, diff)) return 0;
+        i += 16;
+    }
+    return memcmp(a + i, b + i, m - i) == 0;
+}
+#endif
+
+/*
+ * The search kernel, inlined into each of the tiers below so it is compiled for each instruction set,
+ * with the matching verification kernel inlined into it.
+ */
+static inline __attribute__((always_inline))
+int search_kernel(const unsigned char *x, int m, const unsigned char *y, int n, const unsigned int *B, unsigned int Hm,
+                  int (*verify)(const unsigned char *, const unsigned char *, int)) {
+    unsigned int H, V;
+    const int MQ1 = m - Q + 1;
+    int count = 0;
+    int pos = m - 1;
+    // While within the search text:
+    while (pos < n) {
+
+        // If there is a bit set for the hash:
+        H = CHAIN_HASH(y, pos);
+        V = B[H & TABLE_MASK];
+        if (V) {
+
+            // Look at the chain of q-grams that precede it:
+            const int end_second_qgram_pos = pos - m + Q2;
+            while (pos >= end_second_qgram_pos)
+            {
+                pos -= Q;
+                H = CHAIN_HASH(y, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & LINK_HASH(H))) goto shift;
+                V = B[H & TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - verify the pattern if the hash Hm matches as well:
+            pos = end_second_qgram_pos - Q;
+            if (H == Hm && verify(y + pos - END_FIRST_QGRAM, x, m)) {
+                (count)++;
+            }
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+    return count;
+}
+
+typedef int search_kernel_fn(const unsigned char *x, int m, const unsigned char *y, int n, const unsigned int *B, unsigned int Hm);
+
+static int search_scalar(const unsigned char *x, int m, const unsigned char *y, int n, const unsigned int *B, unsigned int Hm) {
+    return search_kernel(x, m, y, n, B, Hm, verify_scalar);
+}
+
+#ifdef X86_KERNELS
+__attribute__((target("sse4.2")))
+static int search_sse42(const unsigned char *x, int m, const unsigned char *y, int n, const unsigned int *B, unsigned int Hm) {
+    return search_kernel(x, m, y, n, B, Hm, verify_sse42);
+}
+
+__attribute__((target("avx2")))
+static int search_avx2(const unsigned char *x, int m, const unsigned char *y, int n, const unsigned int *B, unsigned int Hm) {
+    return search_kernel(x, m, y, n, B, Hm, verify_avx2);
+}
+#endif
+
+/*
+ * The kernel bound at startup.
+ */
+static search_kernel_fn *search_tier = search_scalar;
+
+/*
+ * Detects the CPU features once, before main() runs, and binds the best supported kernel.
+ * A lower tier can be forced by setting HASHCHAIN_KERNEL; a tier the CPU does not support is ignored.
+ */
+__attribute__((constructor))
+static void select_search_tier(void) {
+#ifdef X86_KERNELS
+    __builtin_cpu_init();
+    const int has_sse42 = __builtin_cpu_supports("sse4.2");
+    const int has_avx2  = __builtin_cpu_supports("avx2");
+    if (has_avx2) search_tier = search_avx2;
+    else if (has_sse42) search_tier = search_sse42;
+
+    const char *forced = getenv("HASHCHAIN_KERNEL");
+    if (forced) {
+        if (!strcmp(forced, "scalar")) search_tier = search_scalar;
+        else if (!strcmp(forced, "sse42") && has_sse42) search_tier = search_sse42;
+        else if (!strcmp(forced, "avx2") && has_avx2) search_tier = search_avx2;
+    }
+#endif
+}
+
+/*
+ * Searches for a pattern x of length m in a text y of length n and reports the number of occurrences found.
+ */
+int search(unsigned char *x, int m, unsigned char *y, int n) {
+    if (m < Q) return -1;  // have to be at least Q in length to search.
+
+    unsigned int B[ASIZE];
+
+    /* Preprocessing */
+    BEGIN_PREPROCESSING
+    const unsigned int Hm = preprocessing(x, m, B);
+    END_PREPROCESSING
+
+    /* Searching */
+    BEGIN_SEARCHING
+    int count = search_tier(x, m, y, n, B, Hm);
+    END_SEARCHING
+
+    return count;
+}
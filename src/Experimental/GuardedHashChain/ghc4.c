@@ -0,0 +1,248 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * This is an implementation of the HashChain algorithm, (currently unpublished) by Matt Palmer.
+ * It is a factor search similar to WFR or the QF family of algorithms.
+ *
+ * It builds a hash table containing entries for chains of hashes.  Hashes are chained together by
+ * placing a fingerprint of the *next* hash into the entry for the *current* hash.  This enables
+ * a check for the second hash value to be performed without requiring a second lookup in the hash table.
+ *
+ * It creates Q chains of hashes from the end of the pattern back to the start.
+ *
+ * The guarded version starts searching with the HashChain kernel, which is fastest on average but quadratic
+ * in the worst case.  It counts the bytes scanned back over and verified in each block of GUARD_BLOCK bytes of text.
+ * If that work exceeds GUARD_WORK bytes per byte of text, the filter has degraded, and the rest of the text is searched
+ * with the LinearHashChain kernel, which is linear in the worst case.  Both kernels use the same hash table.
+ *
+ * This implementation is written to integrate with the SMART string search benchmarking tool,
+ * by Simone Faro, Matt Palmer, Stefano Stefano Scafiti and Thierry Lecroq.
+*/
+
+#include "include/define.h"
+#include "include/main.h"
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#define ALPHA 12
+
+/*
+ * Number of bytes in a q-gram.
+ * Chain hash functions defined below must be written to process this number of bytes.
+ */
+#define	Q     4
+
+/*
+ * The size of the blocks of text in which the work done by the HashChain kernel is measured,
+ * and the number of bytes of work per byte of text above which it switches to the linear kernel.
+ */
+#define GUARD_BLOCK 4096
+#define GUARD_WORK  8
+
+/*
+ * Functions and calculated parameters.
+ * Hash functions must be written to use the number of bytes defined in Q. They scan backwards from the initial position.
+ */
+#define S                 ((ALPHA) / (Q))                          // Bit shift for each of the chain hash byte components.
+#define HASH(x, p, s)     ((((((x[p] << (s)) + x[p - 1]) << (s)) + x[p - 2]) << (s)) + x[p - 3]) // General hash function using a bitshift for each byte added.
+#define CHAIN_HASH(x, p)  HASH((x), (p), (S))                      // Hash function for chain hashes, using the S bitshift.
+#define LINK_HASH(H)      (1U << ((H) & 0x1F))                     // Hash fingerprint, taking low 5 bits of the hash to set one of 32 bits.
+#define ASIZE             (1 << (ALPHA))                           // Hash table size.
+#define TABLE_MASK        ((ASIZE) - 1)                            // Mask for table is one less than the power of two size.
+#define Q2                (Q + Q)                                  // 2 Qs.
+#define END_FIRST_QGRAM   (Q - 1)                                  // Position of the end of the first q-gram.
+#define END_SECOND_QGRAM  (Q2 - 1)                                 // Position of the end of the second q-gram.
+
+/*
+ * Builds the KMP failure table, given a pattern x of length m and a list of integers with m + 1 elements.
+ * It adds a failure function to the very end, at position m, to be able to continue searching.
+ */
+void pre_kmp(unsigned char *x, int m, int KMP[])
+{
+    int j = 0;
+    int t = -1;
+    KMP[0] = -1;
+    while (j < m) {
+        while (t > -1 && x[j] != x[t]) {
+            t = KMP[t];
+        }
+        j++; t++;
+        if (j < m && x[j] == x[t]) {
+            KMP[j] = KMP[t];
+        }
+        else {
+            KMP[j] = t;
+        }
+    }
+}
+
+/*
+ * Builds the hash table B of size ASIZE for a string x of length m.
+ * Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int preprocessing(const unsigned char *x, int m, unsigned int *B) {
+
+    // 0. Zero out the hash table.
+    for (int i = 0; i < ASIZE; i++) B[i] = 0;
+
+    // 1. Calculate all the chain hashes, ending with processing the entire pattern so H has the cumulative value.
+    unsigned int H;
+    int last_chain = m < Q2 ? m - END_FIRST_QGRAM : Q;
+    for (int chain_no = last_chain; chain_no >= 1; chain_no--)
+    {
+        H = CHAIN_HASH(x, m - chain_no);
+        for (int chain_pos = m - chain_no - Q; chain_pos >= END_FIRST_QGRAM; chain_pos -=Q)
+        {
+            unsigned int H_last = H;
+            H = CHAIN_HASH(x, chain_pos);
+            B[H_last & TABLE_MASK] |= LINK_HASH(H);
+        }
+    }
+
+    // 2. Add in hashes for the first qgrams that have no preceding value.  Only set a value if there is nothing there already.
+    unsigned int F;
+    int stop = MIN(m, END_SECOND_QGRAM);
+    for (int chain_pos = END_FIRST_QGRAM; chain_pos < stop; chain_pos++)
+    {
+        F = CHAIN_HASH(x, chain_pos);
+        if (!B[F & TABLE_MASK]) B[F & TABLE_MASK] = LINK_HASH(~F);
+    }
+
+    return H; // Return the hash value for processing the last q-gram.
+}
+
+/*
+ * Searches for a pattern x of length m in a text y of length n and reports the number of occurrences found.
+ */
+int search(unsigned char *x, int m, unsigned char *y, int n) {
+    if (m < Q) return -1;  // have to be at least Q in length to search.
+
+    unsigned int H, V, B[ASIZE];
+
+    /* Preprocessing */
+    BEGIN_PREPROCESSING
+    const int MQ1 = m - Q + 1;
+    const unsigned int Hm = preprocessing(x, m, B);
+    END_PREPROCESSING
+
+    /* Searching */
+    BEGIN_SEARCHING
+    int count = 0;
+    int pos = m - 1;
+    int work = 0;
+    int block_end = pos;
+    // While within the search text:
+    while (pos < n) {
+
+        // At the end of each block, switch to the linear kernel if the work done in it was too high:
+        if (pos >= block_end) {
+            if (work > GUARD_WORK * GUARD_BLOCK) goto linear;
+            work = 0;
+            block_end = pos + GUARD_BLOCK;
+        }
+
+        // If there is a bit set for the hash:
+        H = CHAIN_HASH(y, pos);
+        V = B[H & TABLE_MASK];
+        if (V) {
+
+            // Look at the chain of q-grams that precede it, counting the bytes scanned back over:
+            const int window_end_pos = pos;
+            const int end_second_qgram_pos = pos - m + Q2;
+            while (pos >= end_second_qgram_pos)
+            {
+                pos -= Q;
+                H = CHAIN_HASH(y, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & LINK_HASH(H))) {
+                    work += window_end_pos - pos;
+                    goto shift;
+                }
+                V = B[H & TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - verify the pattern if the hash Hm matches as well:
+            pos = end_second_qgram_pos - Q;
+            work += window_end_pos - pos + m;
+            if (H == Hm && memcmp(y + pos - END_FIRST_QGRAM, x, m) == 0) {
+                (count)++;
+            }
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+    END_SEARCHING
+    return count;
+
+    // The filter has degraded - search the rest of the text with the linear kernel.
+    // The HashChain kernel has dealt with every window ending before pos, so KMP starts afresh at the next window.
+    linear:;
+    int KMP[m + 1];
+    pre_kmp(x, m, KMP);
+    int rightmost_match_pos = 0;
+    int next_verify_pos = pos - m + 1;
+    int pattern_pos = 0;
+    // While within the search text:
+    while (pos < n) {
+
+        // If there is a bit set for the hash:
+        H = CHAIN_HASH(y, pos);
+        V = B[H & TABLE_MASK];
+        if (V) {
+            // Calculate how far back to scan and update the right most match pos.
+            const int end_first_qgram_pos = pos - m + Q;
+            const int scan_back_pos = MAX(end_first_qgram_pos, rightmost_match_pos) + Q;
+            rightmost_match_pos = pos;
+
+            // Look at the chain of q-grams that precede it:
+            while (pos >= scan_back_pos)
+            {
+                pos -= Q;
+                H = CHAIN_HASH(y, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & LINK_HASH(H))) goto linear_shift;
+                V = B[H & TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - verify the pattern :
+            const int window_start_pos = end_first_qgram_pos - Q + 1;
+            // Check if we need to re-start KMP if our window start is after last results.
+            if (window_start_pos > next_verify_pos) {
+                next_verify_pos = window_start_pos;
+                pattern_pos = 0;
+            }
+
+            while (pattern_pos >= next_verify_pos - window_start_pos) {
+
+                // Naive string matching - how many characters do we match...
+                while (pattern_pos < m && x[pattern_pos] == y[next_verify_pos]) {
+                    pattern_pos++;
+                    next_verify_pos++;
+                }
+
+                // If we matched the whole length of the pattern (and we're still inside the text), increase match count.
+                if (pattern_pos == m) count++;
+
+                // Get the next matching pattern position.
+                pattern_pos = KMP[pattern_pos];
+                if (pattern_pos < 0) {
+                    pattern_pos++;
+                    next_verify_pos++;
+                }
+            }
+
+            pos = next_verify_pos + m - 1 - pattern_pos;
+            continue;
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        linear_shift:
+        pos += MQ1;
+    }
+    END_SEARCHING
+
+    return count;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * This is an implementation of the HashChain algorithm, (currently unpublished) by Matt Palmer.
+ * It is a factor search similar to WFR or the QF family of algorithms.
+ *
+ * It builds a hash table containing entries for chains of hashes.  Hashes are chained together by
+ * placing a fingerprint of the *next* hash into the entry for the *current* hash.  This enables
+ * a check for the second hash value to be performed without requiring a second lookup in the hash table.
+ *
+ * It creates Q chains of hashes from the end of the pattern back to the start.
+ *
+ * The saturation-aware version is for very long patterns.  As m grows, more and more link bits are set in the
+ * table, until most entries are dense and the filter no longer rejects anything.  After preprocessing it measures
+ * the fraction of bits set in the occupied table entries.  If that is above MAX_SATURATION percent, it first uses
+ * a bigger table, with MAX_ALPHA bits instead of ALPHA.  If the table is still saturated, it only indexes the last
+ * w bytes of the pattern, halving w until the table is no longer saturated.  The search then looks for that suffix,
+ * and verifies the rest of the pattern only when the suffix passes the filter.
+ *
+ * This implementation is written to integrate with the SMART string search benchmarking tool,
+ * by Simone Faro, Matt Palmer, Stefano Stefano Scafiti and Thierry Lecroq.
+*/
+
+#include "include/define.h"
+#include "include/main.h"
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#define ALPHA 11
+
+/*
+ * Number of bytes in a q-gram.
+ * Chain hash functions defined below must be written to process this number of bytes.
+ */
+#define	Q     2
+
+/*
+ * The number of bits in the bigger hash table used if the normal one is saturated,
+ * and the percentage of bits set in the table above which it is considered saturated.
+ */
+#define MAX_ALPHA       ((ALPHA) + 2)
+#define MAX_SATURATION  30
+
+/*
+ * Functions and calculated parameters.
+ * Hash functions must be written to use the number of bytes defined in Q. They scan backwards from the initial position.
+ */
+#define S                 ((ALPHA) / (Q))                          // Bit shift for each of the chain hash byte components.
+#define HASH(x, p, s)     ((((x)[(p)]) << (s)) + ((x)[(p) - 1]))   // General hash function using a bitshift for each byte added.
+#define CHAIN_HASH(x, p)  HASH((x), (p), (S))                      // Hash function for chain hashes, using the S bitshift.
+#define LINK_HASH(H)      (1U << ((H) & 0x1F))                     // Hash fingerprint, taking low 5 bits of the hash to set one of 32 bits.
+#define ASIZE             (1 << (ALPHA))                           // Hash table size.
+#define MAX_ASIZE         (1 << (MAX_ALPHA))                       // Size of the bigger hash table.
+#define Q2                (Q + Q)                                  // 2 Qs.
+#define END_FIRST_QGRAM   (Q - 1)                                  // Position of the end of the first q-gram.
+#define END_SECOND_QGRAM  (Q2 - 1)                                 // Position of the end of the second q-gram.
+
+/*
+ * Builds the hash table B of size mask + 1 for a string x of length m.
+ * Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int preprocessing(const unsigned char *x, int m, unsigned int *B, unsigned int mask) {
+
+    // 0. Zero out the hash table.
+    for (unsigned int i = 0; i <= mask; i++) B[i] = 0;
+
+    // 1. Calculate all the chain hashes, ending with processing the entire pattern so H has the cumulative value.
+    unsigned int H;
+    int last_chain = m < Q2 ? m - END_FIRST_QGRAM : Q;
+    for (int chain_no = last_chain; chain_no >= 1; chain_no--)
+    {
+        H = CHAIN_HASH(x, m - chain_no);
+        for (int chain_pos = m - chain_no - Q; chain_pos >= END_FIRST_QGRAM; chain_pos -=Q)
+        {
+            unsigned int H_last = H;
+            H = CHAIN_HASH(x, chain_pos);
+            B[H_last & mask] |= LINK_HASH(H);
+        }
+    }
+
+    // 2. Add in hashes for the first qgrams that have no preceding value.  Only set a value if there is nothing there already.
+    unsigned int F;
+    int stop = MIN(m, END_SECOND_QGRAM);
+    for (int chain_pos = END_FIRST_QGRAM; chain_pos < stop; chain_pos++)
+    {
+        F = CHAIN_HASH(x, chain_pos);
+        if (!B[F & mask]) B[F & mask] = LINK_HASH(~F);
+    }
+
+    return H; // Return the hash value for processing the last q-gram.
+}
+
+/*
+ * Returns true if more than MAX_SATURATION percent of the bits in the occupied entries of the hash table B
+ * of size mask + 1 are set.  Empty entries are not counted, as a text with a small alphabet such as DNA
+ * only ever hits the few entries its q-grams hash to, however big the table is.
+ */
+int saturated(const unsigned int *B, unsigned int mask) {
+    long bits = 0, entries = 0;
+    for (unsigned int i = 0; i <= mask; i++) {
+        if (B[i]) {
+            bits += __builtin_popcount(B[i]);
+            entries++;
+        }
+    }
+    return bits * 100 > (long) MAX_SATURATION * 32 * entries;
+}
+
+/*
+ * Searches for a pattern x of length m in a text y of length n and reports the number of occurrences found.
+ */
+int search(unsigned char *x, int m, unsigned char *y, int n) {
+    if (m < Q) return -1;  // have to be at least Q in length to search.
+
+    unsigned int H, V, B[MAX_ASIZE];
+
+    /* Preprocessing */
+    BEGIN_PREPROCESSING
+    // Index the whole pattern in the normal table.  If that is saturated, try the bigger table,
+    // then index shorter and shorter suffixes of the pattern of length w until it is not.
+    unsigned int mask = ASIZE - 1;
+    int w = m;
+    unsigned int Hw = preprocessing(x, m, B, mask);
+    if (saturated(B, mask)) {
+        mask = MAX_ASIZE - 1;
+        Hw = preprocessing(x, m, B, mask);
+        while (w >= 2 * Q2 && saturated(B, mask)) {
+            w /= 2;
+            Hw = preprocessing(x + m - w, w, B, mask);
+        }
+    }
+    const int MQ1 = w - Q + 1;
+    const int prefix_len = m - w;
+    END_PREPROCESSING
+
+    /* Searching */
+    BEGIN_SEARCHING
+    int count = 0;
+    int pos = m - 1;
+    // While within the search text:
+    while (pos < n) {
+
+        // If there is a bit set for the hash:
+        H = CHAIN_HASH(y, pos);
+        V = B[H & mask];
+        if (V) {
+
+            // Look at the chain of q-grams that precede it, back to the start of the indexed suffix:
+            const int end_second_qgram_pos = pos - w + Q2;
+            while (pos >= end_second_qgram_pos)
+            {
+                pos -= Q;
+                H = CHAIN_HASH(y, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & LINK_HASH(H))) goto shift;
+                V = B[H & mask];
+            }
+
+            // Matched the chain all the way back to the start of the suffix - verify the whole pattern
+            // if the hash Hw matches as well:
+            pos = end_second_qgram_pos - Q;
+            if (H == Hw && memcmp(y + pos - END_FIRST_QGRAM - prefix_len, x, m) == 0) {
+                (count)++;
+            }
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+    END_SEARCHING
+
+    return count;
+}
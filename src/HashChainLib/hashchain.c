@@ -0,0 +1,375 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Reentrant implementations of the HashChain and LinearHashChain algorithms.
+ * The kernels are identical to the SMART implementations, but use no global state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hashchain.h"
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+/*
+ * Returns the time from a monotonic clock in milliseconds.
+ */
+static double hc_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec * 1e-6;
+}
+
+unsigned int hc_preprocessing(const unsigned char *x, int m, unsigned int *B) {
+
+    // 0. Zero out the hash table.
+    memset(B, 0, HC_ASIZE * sizeof(unsigned int));
+    return hc_link_qgrams(x, m, B);
+}
+
+unsigned int hc_link_qgrams(const unsigned char *x, int m, unsigned int *B) {
+
+    // 1. Calculate all the chain hashes, ending with processing the entire pattern so H has the cumulative value.
+    unsigned int H = 0;
+    int last_chain = m < HC_Q2 ? m - HC_END_FIRST_QGRAM : HC_Q;
+    for (int chain_no = last_chain; chain_no >= 1; chain_no--)
+    {
+        H = hc_chain_hash(x, m - chain_no);
+        for (int chain_pos = m - chain_no - HC_Q; chain_pos >= HC_END_FIRST_QGRAM; chain_pos -= HC_Q)
+        {
+            unsigned int H_last = H;
+            H = hc_chain_hash(x, chain_pos);
+            B[H_last & HC_TABLE_MASK] |= HC_LINK_HASH(H);
+        }
+    }
+
+    // 2. Add in hashes for the first qgrams that have no preceding value.  Only set a value if there is nothing there already.
+    unsigned int F;
+    int stop = MIN(m, HC_END_SECOND_QGRAM);
+    for (int chain_pos = HC_END_FIRST_QGRAM; chain_pos < stop; chain_pos++)
+    {
+        F = hc_chain_hash(x, chain_pos);
+        if (!B[F & HC_TABLE_MASK]) B[F & HC_TABLE_MASK] = HC_LINK_HASH(~F);
+    }
+
+    return H; // Return the hash value for processing the last q-gram.
+}
+
+void hc_pre_kmp(const unsigned char *x, int m, int *KMP) {
+    int j = 0;
+    int t = -1;
+    KMP[0] = -1;
+    while (j < m) {
+        while (t > -1 && x[j] != x[t]) {
+            t = KMP[t];
+        }
+        j++; t++;
+        if (j < m && x[j] == x[t]) {
+            KMP[j] = KMP[t];
+        }
+        else {
+            KMP[j] = t;
+        }
+    }
+}
+
+size_t hc_pattern_size(int m) {
+    // The KMP table and a copy of the pattern are stored in the same allocation, after the hash table.
+    return sizeof(hc_pattern) + (m + 1) * sizeof(int) + m;
+}
+
+hc_pattern *hc_compile_at(void *memory, const unsigned char *x, int m, hc_context *ctx) {
+    if (m < HC_Q) return NULL;  // have to be at least Q in length to search.
+
+    const double start = ctx && ctx->timed ? hc_time_ms() : 0;
+
+    hc_pattern *p = memory;
+    int *kmp = (int *) (p + 1);
+    unsigned char *copy = (unsigned char *) (kmp + m + 1);
+    memcpy(copy, x, m);
+    p->m = m;
+    p->x = copy;
+    p->kmp = kmp;
+    p->Hm = hc_preprocessing(copy, m, p->B);
+    hc_pre_kmp(copy, m, kmp);
+
+    if (ctx && ctx->timed) ctx->pre_time = hc_time_ms() - start;
+    return p;
+}
+
+hc_pattern *hc_compile(const unsigned char *x, int m, hc_context *ctx) {
+    if (m < HC_Q) return NULL;  // have to be at least Q in length to search.
+    void *memory = malloc(hc_pattern_size(m));
+    return memory ? hc_compile_at(memory, x, m, ctx) : NULL;
+}
+
+void hc_free(hc_pattern *p) {
+    free(p);
+}
+
+void hc_state_init(hc_state *s, const hc_pattern *p) {
+    s->pos = p->m - 1;
+    s->count = 0;
+    s->rightmost_match_pos = 0;
+    s->next_verify_pos = 0;
+    s->pattern_pos = 0;
+}
+
+/*
+ * Returns the position the main loop must stop at, to process at most budget bytes of the text.
+ */
+static inline long hc_stop_pos(long pos, long n, long budget) {
+    return budget >= n - pos ? n : pos + budget;
+}
+
+/*
+ * Returns the chain hash of the q-gram ending at pos in the text y, or the narrowed hash precomputed for it
+ * if there are precomputed hashes.  The kernels are inlined with hashes either NULL or not, so there is no test.
+ */
+static inline __attribute__((always_inline))
+unsigned int hc_hash_at(const unsigned char *y, const hc_text_hash *hashes, long pos) {
+    return hashes ? hashes[pos] : hc_chain_hash(y, pos);
+}
+
+/*
+ * The HashChain kernel, reading hashes from the precomputed hashes if they are not NULL.
+ */
+static inline __attribute__((always_inline))
+int hc_search_kernel(const hc_pattern *p, const unsigned char *y, const hc_text_hash *hashes, long n,
+                     hc_state *s, long budget, hc_context *ctx) {
+    const double start = ctx && ctx->timed ? hc_time_ms() : 0;
+    hc_match_fn *on_match = ctx ? ctx->on_match : NULL;
+
+    const unsigned int *B = p->B;
+    const unsigned char *x = p->x;
+    const int m = p->m;
+    const unsigned int Hm = hashes ? p->Hm & HC_TABLE_MASK : p->Hm;
+    const int MQ1 = m - HC_Q + 1;
+    unsigned int H, V;
+    long count = s->count;
+    long pos = s->pos;
+    long stop = hc_stop_pos(pos, n, budget);
+    // While within the search text and the budget:
+    while (pos < stop) {
+
+        // If there is a bit set for the hash:
+        H = hc_hash_at(y, hashes, pos);
+        V = B[H & HC_TABLE_MASK];
+        if (V) {
+
+            // Look at the chain of q-grams that precede it:
+            const long end_second_qgram_pos = pos - m + HC_Q2;
+            while (pos >= end_second_qgram_pos)
+            {
+                pos -= HC_Q;
+                H = hc_hash_at(y, hashes, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & HC_LINK_HASH(H))) goto shift;
+                V = B[H & HC_TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - verify the pattern if the hash Hm matches as well:
+            pos = end_second_qgram_pos - HC_Q;
+            if (H == Hm && memcmp(y + pos - HC_END_FIRST_QGRAM, x, m) == 0) {
+                count++;
+                // If asked to stop, return once this position has been passed, so the search can be resumed after it.
+                if (on_match && on_match(ctx->match_data, pos - HC_END_FIRST_QGRAM)) stop = MIN(stop, pos + MQ1);
+            }
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+
+    s->pos = pos;
+    s->count = count;
+    if (ctx && ctx->timed) ctx->run_time = hc_time_ms() - start;
+    return pos < n;
+}
+
+/*
+ * The LinearHashChain kernel, reading hashes from the precomputed hashes if they are not NULL.
+ */
+static inline __attribute__((always_inline))
+int hc_search_linear_kernel(const hc_pattern *p, const unsigned char *y, const hc_text_hash *hashes, long n,
+                            hc_state *s, long budget, hc_context *ctx) {
+    const double start = ctx && ctx->timed ? hc_time_ms() : 0;
+    hc_match_fn *on_match = ctx ? ctx->on_match : NULL;
+
+    const unsigned int *B = p->B;
+    const unsigned char *x = p->x;
+    const int *KMP = p->kmp;
+    const int m = p->m;
+    const int MQ1 = m - HC_Q + 1;
+    unsigned int H, V;
+    long count = s->count;
+    long pos = s->pos;
+    long rightmost_match_pos = s->rightmost_match_pos;
+    long next_verify_pos = s->next_verify_pos;
+    int pattern_pos = s->pattern_pos;
+    long stop = hc_stop_pos(pos, n, budget);
+    // While within the search text and the budget:
+    while (pos < stop) {
+
+        // If there is a bit set for the hash:
+        H = hc_hash_at(y, hashes, pos);
+        V = B[H & HC_TABLE_MASK];
+        if (V) {
+            // Calculate how far back to scan and update the right most match pos.
+            const long end_first_qgram_pos = pos - m + HC_Q;
+            const long scan_back_pos = MAX(end_first_qgram_pos, rightmost_match_pos) + HC_Q;
+            rightmost_match_pos = pos;
+
+            // Look at the chain of q-grams that precede it:
+            while (pos >= scan_back_pos)
+            {
+                pos -= HC_Q;
+                H = hc_hash_at(y, hashes, pos);
+                // If we have no match for this chain q-gram, break out and go around the main loop again:
+                if (!(V & HC_LINK_HASH(H))) goto shift;
+                V = B[H & HC_TABLE_MASK];
+            }
+
+            // Matched the chain all the way back to the start - verify the pattern with KMP.
+            // Check if we need to re-start KMP if our window start is after last results.
+            const long window_start_pos = end_first_qgram_pos - HC_Q + 1;
+            if (window_start_pos > next_verify_pos) {
+                next_verify_pos = window_start_pos;
+                pattern_pos = 0;
+            }
+
+            int stopping = 0;
+            while (pattern_pos >= next_verify_pos - window_start_pos) {
+
+                // Naive string matching - how many characters do we match...
+                while (pattern_pos < m && x[pattern_pos] == y[next_verify_pos]) {
+                    pattern_pos++;
+                    next_verify_pos++;
+                }
+
+                // If we matched the whole length of the pattern, increase match count.
+                if (pattern_pos == m) {
+                    count++;
+                    if (on_match && on_match(ctx->match_data, next_verify_pos - m)) stopping = 1;
+                }
+
+                // Get the next matching pattern position.
+                pattern_pos = KMP[pattern_pos];
+                if (pattern_pos < 0) {
+                    pattern_pos++;
+                    next_verify_pos++;
+                }
+            }
+
+            pos = next_verify_pos + m - 1 - pattern_pos;
+            // If asked to stop, return now: the KMP state is complete for this window, so the search can be resumed.
+            if (stopping) break;
+            continue;
+        }
+
+        // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+        shift:
+        pos += MQ1;
+    }
+
+    s->pos = pos;
+    s->count = count;
+    s->rightmost_match_pos = rightmost_match_pos;
+    s->next_verify_pos = next_verify_pos;
+    s->pattern_pos = pattern_pos;
+    if (ctx && ctx->timed) ctx->run_time = hc_time_ms() - start;
+    return pos < n;
+}
+
+int hc_search_resume(const hc_pattern *p, const unsigned char *y, long n, hc_state *s, long budget, hc_context *ctx) {
+    return hc_search_kernel(p, y, NULL, n, s, budget, ctx);
+}
+
+int hc_search_linear_resume(const hc_pattern *p, const unsigned char *y, long n, hc_state *s, long budget, hc_context *ctx) {
+    return hc_search_linear_kernel(p, y, NULL, n, s, budget, ctx);
+}
+
+long hc_search(const hc_pattern *p, const unsigned char *y, long n, hc_context *ctx) {
+    hc_state s;
+    hc_state_init(&s, p);
+    hc_search_resume(p, y, n, &s, n, ctx);
+    return s.count;
+}
+
+long hc_search_linear(const hc_pattern *p, const unsigned char *y, long n, hc_context *ctx) {
+    hc_state s;
+    hc_state_init(&s, p);
+    hc_search_linear_resume(p, y, n, &s, n, ctx);
+    return s.count;
+}
+
+/*
+ * Computes the narrowed hash of each q-gram of a text y of length n into hashes.  Each hash only depends on the
+ * bytes of its own q-gram, so the loop has no carried dependency, and the compiler vectorises it.
+ */
+static inline __attribute__((always_inline))
+void hc_hash_text_kernel(const unsigned char *y, long n, hc_text_hash *hashes) {
+    for (long pos = 0; pos < HC_END_FIRST_QGRAM && pos < n; pos++) hashes[pos] = 0;
+    for (long pos = HC_END_FIRST_QGRAM; pos < n; pos++) {
+        hashes[pos] = (hc_text_hash) (hc_chain_hash(y, pos) & HC_TABLE_MASK);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void hc_hash_text_avx2(const unsigned char *y, long n, hc_text_hash *hashes) {
+    hc_hash_text_kernel(y, n, hashes);
+}
+#endif
+
+static void hc_hash_text(const unsigned char *y, long n, hc_text_hash *hashes) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        hc_hash_text_avx2(y, n, hashes);
+        return;
+    }
+#endif
+    hc_hash_text_kernel(y, n, hashes);
+}
+
+hc_text_hashes *hc_text_hashes_create(const unsigned char *y, long n) {
+    // The hashes are stored in the same allocation, after the struct.
+    hc_text_hashes *t = malloc(sizeof(hc_text_hashes) + n * sizeof(hc_text_hash));
+    if (!t) return NULL;
+    t->y = y;
+    t->n = n;
+    t->hashes = (hc_text_hash *) (t + 1);
+    hc_hash_text(y, n, t->hashes);
+    return t;
+}
+
+void hc_text_hashes_free(hc_text_hashes *t) {
+    free(t);
+}
+
+int hc_search_hashed_resume(const hc_pattern *p, const hc_text_hashes *t, hc_state *s, long budget, hc_context *ctx) {
+    return hc_search_kernel(p, t->y, t->hashes, t->n, s, budget, ctx);
+}
+
+int hc_search_linear_hashed_resume(const hc_pattern *p, const hc_text_hashes *t, hc_state *s, long budget,
+                                   hc_context *ctx) {
+    return hc_search_linear_kernel(p, t->y, t->hashes, t->n, s, budget, ctx);
+}
+
+long hc_search_hashed(const hc_pattern *p, const hc_text_hashes *t, hc_context *ctx) {
+    hc_state s;
+    hc_state_init(&s, p);
+    hc_search_hashed_resume(p, t, &s, t->n, ctx);
+    return s.count;
+}
+
+long hc_search_linear_hashed(const hc_pattern *p, const hc_text_hashes *t, hc_context *ctx) {
+    hc_state s;
+    hc_state_init(&s, p);
+    hc_search_linear_hashed_resume(p, t, &s, t->n, ctx);
+    return s.count;
+}
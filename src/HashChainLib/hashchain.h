@@ -0,0 +1,203 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Reentrant HashChain library.
+ *
+ * The SMART implementations of HashChain record their timings in the global variables defined by main.h,
+ * so they cannot be called from more than one thread at a time.  This library provides the same algorithms
+ * with no global state.  A pattern is compiled once into an immutable hc_pattern, which can then be searched
+ * for concurrently from any number of threads.  Timing and match reporting are optional, and are passed in
+ * to each call in an hc_context owned by the caller.
+ */
+
+#ifndef HASHCHAIN_H
+#define HASHCHAIN_H
+
+#include <stddef.h>
+
+/*
+ * Alpha - the number of bits in the hash table.
+ */
+#ifndef HC_ALPHA
+#define HC_ALPHA 12
+#endif
+
+/*
+ * Number of bytes in a q-gram.
+ */
+#ifndef HC_Q
+#define HC_Q     4
+#endif
+
+/*
+ * Functions and calculated parameters.
+ */
+#define HC_S                 ((HC_ALPHA) / (HC_Q))              // Bit shift for each of the chain hash byte components.
+#define HC_LINK_HASH(H)      (1U << ((H) & 0x1F))               // Hash fingerprint, taking low 5 bits of the hash to set one of 32 bits.
+#define HC_ASIZE             (1 << (HC_ALPHA))                  // Hash table size.
+#define HC_TABLE_MASK        ((HC_ASIZE) - 1)                   // Mask for table is one less than the power of two size.
+#define HC_Q2                (HC_Q + HC_Q)                      // 2 Qs.
+#define HC_END_FIRST_QGRAM   (HC_Q - 1)                         // Position of the end of the first q-gram.
+#define HC_END_SECOND_QGRAM  (HC_Q2 - 1)                        // Position of the end of the second q-gram.
+
+/*
+ * Hash function for chain hashes, processing HC_Q bytes backwards from position p, using the HC_S bitshift.
+ * The loop has a constant trip count and is fully unrolled by the compiler.
+ */
+static inline unsigned int hc_chain_hash(const unsigned char *x, long p) {
+    unsigned int H = x[p];
+    for (int i = 1; i < HC_Q; i++) H = (H << HC_S) + x[p - i];
+    return H;
+}
+
+/*
+ * A compiled pattern.  It is never modified after hc_compile() returns, so it can be shared between threads.
+ */
+typedef struct hc_pattern {
+    int m;                      // Length of the pattern.
+    unsigned int Hm;            // Hash value of the first q-gram, reached when a chain is matched back to the start.
+    const unsigned char *x;     // Copy of the pattern, stored after the struct.
+    const int *kmp;             // KMP failure table with m + 1 entries, used by the linear kernel.
+    unsigned int B[HC_ASIZE];   // The hash chain table.
+} hc_pattern;
+
+/*
+ * Called for each match found at position pos in the text.  Return non-zero to stop the search.
+ */
+typedef int hc_match_fn(void *data, long pos);
+
+struct hc_arena;
+
+/*
+ * Optional per-call context.  Any call taking a context accepts NULL if neither timing nor matches are wanted.
+ */
+typedef struct hc_context {
+    hc_match_fn *on_match;      // If not NULL, called for each match found.
+    void *match_data;           // Passed to on_match.
+    int timed;                  // If non-zero, the times below are recorded.
+    double pre_time;            // Preprocessing time of the last compile, in milliseconds.
+    double run_time;            // Searching time of the last search, in milliseconds.
+    struct hc_arena *arena;     // If not NULL, searches take scratch memory from it, and rewind it before returning.
+} hc_context;
+
+/*
+ * Compiles a pattern x of length m.  Returns NULL if the pattern is shorter than HC_Q or memory cannot be allocated.
+ */
+hc_pattern *hc_compile(const unsigned char *x, int m, hc_context *ctx);
+
+/*
+ * Frees a compiled pattern.
+ */
+void hc_free(hc_pattern *p);
+
+/*
+ * Returns the number of bytes a compiled pattern of length m takes.
+ */
+size_t hc_pattern_size(int m);
+
+/*
+ * Compiles a pattern x of length m into memory supplied by the caller, of at least hc_pattern_size(m) bytes,
+ * which must stay valid for as long as the pattern is used.  It must not be passed to hc_free().
+ * Returns NULL if the pattern is shorter than HC_Q.
+ */
+hc_pattern *hc_compile_at(void *memory, const unsigned char *x, int m, hc_context *ctx);
+
+/*
+ * Builds the hash table B of size HC_ASIZE for a string x of length m.
+ * Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int hc_preprocessing(const unsigned char *x, int m, unsigned int *B);
+
+/*
+ * Builds the hash table B for a string x of length m as hc_preprocessing() does, but without zeroing it first.
+ * B must already be zeroed.  Returns the 32-bit hash value of matching the entire pattern.
+ */
+unsigned int hc_link_qgrams(const unsigned char *x, int m, unsigned int *B);
+
+/*
+ * Builds the KMP failure table for a pattern x of length m into KMP, which has m + 1 elements.
+ */
+void hc_pre_kmp(const unsigned char *x, int m, int *KMP);
+
+/*
+ * Searches a text y of length n for a compiled pattern with the HashChain kernel.
+ * Returns the number of matches found.  If on_match asks to stop, returns the number found so far.
+ */
+long hc_search(const hc_pattern *p, const unsigned char *y, long n, hc_context *ctx);
+
+/*
+ * Searches a text y of length n for a compiled pattern with the LinearHashChain kernel,
+ * which remains linear in the worst case.  Returns the number of matches found.
+ */
+long hc_search_linear(const hc_pattern *p, const unsigned char *y, long n, hc_context *ctx);
+
+/*
+ * The state of a resumable search, so a long search can be split into many calls which each do a bounded
+ * amount of work.  It holds the position in the text, the number of matches found so far, and for the linear
+ * kernel the rightmost filtered position and the KMP verification state.
+ */
+typedef struct hc_state {
+    long pos;                   // Position of the end of the next window to examine.
+    long count;                 // Matches found so far.
+    long rightmost_match_pos;   // Linear kernel only: the rightmost position previously matched in filtering.
+    long next_verify_pos;       // Linear kernel only: the next text position KMP verification reads.
+    int pattern_pos;            // Linear kernel only: the pattern position KMP verification has matched up to.
+} hc_state;
+
+/*
+ * Initialises the state to search from the start of a text.
+ */
+void hc_state_init(hc_state *s, const hc_pattern *p);
+
+/*
+ * Continues a search of a text y of length n from the state s, advancing at most budget bytes through the text.
+ * The next call continues exactly where this one stopped.  It also returns early, just after a match, if on_match
+ * asks to stop.  Returns non-zero if there is more of the text to search, and zero once the search is complete.
+ * The matches found so far are in s->count.
+ */
+int hc_search_resume(const hc_pattern *p, const unsigned char *y, long n, hc_state *s, long budget, hc_context *ctx);
+int hc_search_linear_resume(const hc_pattern *p, const unsigned char *y, long n, hc_state *s, long budget, hc_context *ctx);
+
+/*
+ * The hash of a q-gram narrowed to HC_ALPHA bits, which is all of it the kernels use, apart from the check against
+ * Hm before verification.
+ */
+#if HC_ALPHA <= 16
+typedef unsigned short hc_text_hash;
+#else
+typedef unsigned int hc_text_hash;
+#endif
+
+/*
+ * Precomputed q-gram hashes of a text, for searching the same text for many patterns without hashing it again
+ * for each one.  hashes[pos] is the narrowed hash of the q-gram ending at pos.  It is never modified after
+ * hc_text_hashes_create() returns, so it can be shared between threads.
+ */
+typedef struct hc_text_hashes {
+    const unsigned char *y;     // The text, which must not change or be freed while the hashes are in use.
+    long n;                     // Length of the text.
+    hc_text_hash *hashes;       // Hash of the q-gram ending at each position, stored after the struct.
+} hc_text_hashes;
+
+/*
+ * Computes the hashes of every q-gram in a text y of length n, using SIMD instructions where available.
+ * Returns NULL if memory cannot be allocated.
+ */
+hc_text_hashes *hc_text_hashes_create(const unsigned char *y, long n);
+
+/*
+ * Frees precomputed text hashes.  The text itself is not freed.
+ */
+void hc_text_hashes_free(hc_text_hashes *t);
+
+/*
+ * Search the text of precomputed hashes t for a compiled pattern, reading the hashes instead of hashing the text.
+ * They behave exactly as hc_search(), hc_search_linear() and their resumable versions.
+ */
+long hc_search_hashed(const hc_pattern *p, const hc_text_hashes *t, hc_context *ctx);
+long hc_search_linear_hashed(const hc_pattern *p, const hc_text_hashes *t, hc_context *ctx);
+int hc_search_hashed_resume(const hc_pattern *p, const hc_text_hashes *t, hc_state *s, long budget, hc_context *ctx);
+int hc_search_linear_hashed_resume(const hc_pattern *p, const hc_text_hashes *t, hc_state *s, long budget,
+                                   hc_context *ctx);
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Header-only C++ interface to the HashChain library.  Needs C++20, and linking with hashchain.c.
+ *
+ * hashchain::searcher holds a compiled pattern, and can be passed to std::search like the standard searchers:
+ *
+ *     auto it = std::search(text.begin(), text.end(), hashchain::searcher(needle));
+ *
+ * hashchain::matches() returns a lazy range of the offsets of every match of a pattern in a text, found one at a
+ * time by the resumable kernel as the range is iterated, with no allocation for each match:
+ *
+ *     for (std::size_t offset : hashchain::matches(s, text)) ...
+ *
+ * Texts can be any contiguous range of bytes: std::string_view, std::span<const std::byte>, or a memory mapped
+ * file from hashchain::mapped_file.
+ */
+
+#ifndef HASHCHAIN_HPP
+#define HASHCHAIN_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+#define HC_HAS_MMAP 1
+#endif
+
+extern "C" {
+#include "hashchain.h"
+}
+
+namespace hashchain {
+
+/*
+ * A contiguous iterator over single bytes, such as char, unsigned char or std::byte.
+ */
+template <class It>
+concept byte_iterator = std::contiguous_iterator<It> && sizeof(std::iter_value_t<It>) == 1;
+
+/*
+ * A contiguous range of single bytes.
+ */
+template <class R>
+concept byte_range = std::ranges::contiguous_range<R> && sizeof(std::ranges::range_value_t<R>) == 1;
+
+namespace detail {
+
+struct pattern_deleter {
+    void operator()(hc_pattern *p) const { hc_free(p); }
+};
+
+template <byte_range R>
+std::string_view as_chars(const R &r) {
+    return std::string_view(reinterpret_cast<const char *>(std::ranges::data(r)), std::ranges::size(r));
+}
+
+/*
+ * Records the first match reported by a resumed search, and asks it to stop.
+ */
+inline int stop_at_match(void *data, long pos) {
+    *static_cast<long *>(data) = pos;
+    return 1;
+}
+
+} // namespace detail
+
+/*
+ * A compiled pattern, which can be used with std::search.  It is immutable, so copies are cheap and share the
+ * compiled pattern, and it can be used from any number of threads at once.
+ *
+ * Patterns shorter than HC_Q cannot be compiled, and are searched for with std::string_view::find instead.
+ * A default constructed searcher has an empty pattern, which matches at every position.
+ */
+class searcher {
+public:
+    template <byte_iterator It>
+    searcher(It first, It last) : searcher(std::string_view(reinterpret_cast<const char *>(std::to_address(first)),
+                                                            static_cast<std::size_t>(last - first))) {}
+
+    template <byte_range R>
+        requires (!std::is_convertible_v<const R &, std::string_view>)
+    explicit searcher(const R &pattern) : searcher(detail::as_chars(pattern)) {}
+
+    searcher() = default;
+
+    explicit searcher(std::string_view pattern) : m_(static_cast<long>(pattern.size())) {
+        if (pattern.size() < HC_Q) {
+            short_.assign(pattern);
+            return;
+        }
+        hc_pattern *p = hc_compile(reinterpret_cast<const unsigned char *>(pattern.data()), static_cast<int>(m_), nullptr);
+        if (!p) throw std::bad_alloc();
+        p_ = std::shared_ptr<const hc_pattern>(p, detail::pattern_deleter());
+    }
+
+    /*
+     * Returns the first match in [first, last) as the pair of iterators it spans, or (last, last) if there is none.
+     */
+    template <byte_iterator It>
+    std::pair<It, It> operator()(It first, It last) const {
+        const std::string_view text(reinterpret_cast<const char *>(std::to_address(first)),
+                                    static_cast<std::size_t>(last - first));
+        const long pos = find(text, 0);
+        if (pos < 0) return { last, last };
+        return { first + pos, first + pos + m_ };
+    }
+
+    /*
+     * Returns the offset of the first match in text starting at or after from, or -1 if there is none.
+     */
+    long find(std::string_view text, long from) const {
+        if (!p_) {
+            const std::size_t pos = text.find(short_, static_cast<std::size_t>(from));
+            return pos == std::string_view::npos ? -1 : static_cast<long>(pos);
+        }
+        hc_state s;
+        hc_state_init(&s, p_.get());
+        s.pos += from;
+        return resume(text, &s);
+    }
+
+    /*
+     * Continues a search of text from the state s, returning the offset of the next match, or -1 if there is none.
+     */
+    long resume(std::string_view text, hc_state *s) const {
+        long pos = -1;
+        hc_context ctx = { detail::stop_at_match, &pos, 0, 0, 0, nullptr };
+        const long n = static_cast<long>(text.size());
+        hc_search_resume(p_.get(), reinterpret_cast<const unsigned char *>(text.data()), n, s, n, &ctx);
+        return pos;
+    }
+
+    std::size_t size() const { return static_cast<std::size_t>(m_); }
+    const hc_pattern *pattern() const { return p_.get(); }
+
+private:
+    std::shared_ptr<const hc_pattern> p_;   // Null if the pattern is shorter than HC_Q.
+    std::string short_;                     // A pattern shorter than HC_Q.
+    long m_ = 0;
+};
+
+/*
+ * A lazy, forward range of the offsets of every match of a pattern in a text, in order.  Matches may overlap.
+ * The text must stay valid while the range is used.  Each iterator carries its own search state, so iterating
+ * does not allocate.
+ */
+class match_view : public std::ranges::view_interface<match_view> {
+public:
+    class iterator {
+    public:
+        using value_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() = default;
+
+        std::size_t operator*() const { return static_cast<std::size_t>(match_); }
+
+        iterator &operator++() {
+            next();
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator old = *this;
+            next();
+            return old;
+        }
+
+        friend bool operator==(const iterator &a, const iterator &b) { return a.match_ == b.match_; }
+        friend bool operator==(const iterator &a, std::default_sentinel_t) { return a.match_ < 0; }
+
+    private:
+        friend class match_view;
+
+        iterator(const searcher *s, std::string_view text) : searcher_(s), text_(text) {
+            if (const hc_pattern *p = s->pattern()) hc_state_init(&state_, p);
+            next();
+        }
+
+        void next() {
+            // Short patterns have no kernel state: search again from just after the last match.
+            match_ = searcher_->pattern() ? searcher_->resume(text_, &state_) : searcher_->find(text_, match_ + 1);
+        }
+
+        const searcher *searcher_ = nullptr;
+        std::string_view text_;
+        hc_state state_ = {};
+        long match_ = -1;
+    };
+
+    match_view() = default;
+    match_view(searcher s, std::string_view text) : searcher_(std::move(s)), text_(text) {}
+
+    iterator begin() const { return iterator(&searcher_, text_); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+    searcher searcher_;
+    std::string_view text_;
+};
+
+/*
+ * Returns a lazy range of the offsets of every match of the searcher's pattern in a text.
+ */
+inline match_view matches(searcher s, std::string_view text) {
+    return match_view(std::move(s), text);
+}
+
+template <byte_range R>
+    requires (!std::is_convertible_v<const R &, std::string_view>)
+match_view matches(searcher s, const R &text) {
+    return match_view(std::move(s), detail::as_chars(text));
+}
+
+#ifdef HC_HAS_MMAP
+/*
+ * A read-only memory mapping of a whole file, which can be searched as a range of bytes.
+ */
+class mapped_file {
+public:
+    explicit mapped_file(const char *path) {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), path);
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ > 0) {
+            void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), path);
+            }
+            data_ = static_cast<const std::byte *>(data);
+        }
+        ::close(fd);
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    ~mapped_file() {
+        if (data_) ::munmap(const_cast<std::byte *>(data_), size_);
+    }
+
+    const std::byte *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    const std::byte *begin() const { return data_; }
+    const std::byte *end() const { return data_ + size_; }
+    std::span<const std::byte> bytes() const { return { data_, size_ }; }
+
+private:
+    const std::byte *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+} // namespace hashchain
+
+#endif
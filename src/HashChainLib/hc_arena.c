@@ -0,0 +1,130 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Arena allocation for compiled patterns and search scratch memory.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdlib.h>
+#include "hc_arena.h"
+
+/*
+ * The block header is padded to the alignment, so the memory after it is aligned too.
+ */
+#define HC_ARENA_HEADER ((sizeof(hc_arena_block) + HC_ARENA_ALIGN - 1) & ~(size_t) (HC_ARENA_ALIGN - 1))
+
+static inline size_t hc_arena_round(size_t size) {
+    return (size + HC_ARENA_ALIGN - 1) & ~(size_t) (HC_ARENA_ALIGN - 1);
+}
+
+static inline unsigned char *hc_arena_memory(hc_arena_block *block) {
+    return (unsigned char *) block + HC_ARENA_HEADER;
+}
+
+static hc_arena_block *hc_arena_block_create(size_t size) {
+    void *memory;
+    if (posix_memalign(&memory, HC_ARENA_ALIGN, HC_ARENA_HEADER + size)) return NULL;
+    hc_arena_block *block = memory;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+hc_arena *hc_arena_create(size_t block_size) {
+    hc_arena *a = malloc(sizeof(hc_arena));
+    if (!a) return NULL;
+    a->first = NULL;
+    a->current = NULL;
+    a->block_size = hc_arena_round(block_size ? block_size : HC_ARENA_BLOCK);
+    return a;
+}
+
+void hc_arena_destroy(hc_arena *a) {
+    if (!a) return;
+    hc_arena_block *block = a->first;
+    while (block) {
+        hc_arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(a);
+}
+
+void *hc_arena_alloc(hc_arena *a, size_t size) {
+    size = hc_arena_round(size ? size : 1);
+
+    // Bump the pointer in the current block if it has room.
+    hc_arena_block *block = a->current;
+    if (block && block->size - block->used >= size) {
+        void *memory = hc_arena_memory(block) + block->used;
+        block->used += size;
+        return memory;
+    }
+
+    // Move on to the next block, which is empty, if it is big enough.  Otherwise insert a new block after the current
+    // one, so the blocks kept after it by a reset or rewind are still reused.
+    hc_arena_block *next = block ? block->next : a->first;
+    if (!next || next->size < size) {
+        hc_arena_block *fresh = hc_arena_block_create(size > a->block_size ? size : a->block_size);
+        if (!fresh) return NULL;
+        fresh->next = next;
+        if (block) block->next = fresh;
+        else a->first = fresh;
+        next = fresh;
+    }
+    next->used = size;
+    a->current = next;
+    return hc_arena_memory(next);
+}
+
+void hc_arena_reset(hc_arena *a) {
+    for (hc_arena_block *block = a->first; block; block = block->next) block->used = 0;
+    a->current = NULL;
+}
+
+hc_arena_mark hc_arena_get_mark(const hc_arena *a) {
+    hc_arena_mark mark = { a->current, a->current ? a->current->used : 0 };
+    return mark;
+}
+
+void hc_arena_rewind(hc_arena *a, hc_arena_mark mark) {
+    if (!mark.block) {
+        hc_arena_reset(a);
+        return;
+    }
+    for (hc_arena_block *block = mark.block->next; block; block = block->next) block->used = 0;
+    mark.block->used = mark.used;
+    a->current = mark.block;
+}
+
+static pthread_key_t hc_arena_key;
+static pthread_once_t hc_arena_once = PTHREAD_ONCE_INIT;
+
+static void hc_arena_thread_exit(void *a) {
+    hc_arena_destroy(a);
+}
+
+static void hc_arena_key_create(void) {
+    pthread_key_create(&hc_arena_key, hc_arena_thread_exit);
+}
+
+hc_arena *hc_arena_thread(void) {
+    pthread_once(&hc_arena_once, hc_arena_key_create);
+    hc_arena *a = pthread_getspecific(hc_arena_key);
+    if (!a) {
+        a = hc_arena_create(HC_ARENA_BLOCK);
+        if (a && pthread_setspecific(hc_arena_key, a)) {
+            hc_arena_destroy(a);
+            return NULL;
+        }
+    }
+    return a;
+}
+
+hc_pattern *hc_compile_arena(hc_arena *a, const unsigned char *x, int m, hc_context *ctx) {
+    if (m < HC_Q) return NULL;  // have to be at least Q in length to search.
+    void *memory = hc_arena_alloc(a, hc_pattern_size(m));
+    return memory ? hc_compile_at(memory, x, m, ctx) : NULL;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Arena allocation for compiled patterns and search scratch memory.
+ *
+ * Compiling many patterns makes many small allocations, and some searches need scratch memory for each call.
+ * An arena hands out cache-line-aligned memory from large blocks by bumping a pointer, and frees all of it at once,
+ * so patterns compiled into one arena are laid out contiguously, and a search given an arena in its hc_context
+ * makes no calls to malloc once the arena has grown to the size it needs.
+ */
+
+#ifndef HC_ARENA_H
+#define HC_ARENA_H
+
+#include <stddef.h>
+#include "hashchain.h"
+
+/*
+ * Alignment of every allocation, and of the blocks.
+ */
+#define HC_ARENA_ALIGN 64
+
+/*
+ * The default size of the blocks of a per-thread arena.
+ */
+#ifndef HC_ARENA_BLOCK
+#define HC_ARENA_BLOCK 65536
+#endif
+
+typedef struct hc_arena_block {
+    struct hc_arena_block *next;
+    size_t size;                // Bytes available in the block, after the header.
+    size_t used;
+} hc_arena_block;
+
+/*
+ * An arena.  It is not thread safe: each thread should use its own, such as the one from hc_arena_thread().
+ */
+typedef struct hc_arena {
+    hc_arena_block *first;
+    hc_arena_block *current;    // The block allocations are taken from, or NULL if none is.  Blocks after it are empty.
+    size_t block_size;          // The size of new blocks, unless an allocation needs a bigger one.
+} hc_arena;
+
+/*
+ * A position in an arena, to rewind to later.
+ */
+typedef struct hc_arena_mark {
+    hc_arena_block *block;
+    size_t used;
+} hc_arena_mark;
+
+/*
+ * Creates an arena which allocates blocks of block_size bytes.  No block is allocated until it is first used.
+ * Returns NULL if memory cannot be allocated.  Destroying an arena frees everything allocated from it.
+ */
+hc_arena *hc_arena_create(size_t block_size);
+void hc_arena_destroy(hc_arena *a);
+
+/*
+ * Allocates size bytes aligned to HC_ARENA_ALIGN.  Returns NULL if memory cannot be allocated.
+ */
+void *hc_arena_alloc(hc_arena *a, size_t size);
+
+/*
+ * Frees everything allocated from the arena at once, keeping its blocks to be reused.
+ */
+void hc_arena_reset(hc_arena *a);
+
+/*
+ * Marks the current position of the arena, and frees everything allocated since a mark, keeping the blocks.
+ */
+hc_arena_mark hc_arena_get_mark(const hc_arena *a);
+void hc_arena_rewind(hc_arena *a, hc_arena_mark mark);
+
+/*
+ * Returns the calling thread's own arena, creating it on first use, or NULL if memory cannot be allocated.
+ * It is destroyed when the thread exits.  Searches rewind it to where it was before they return, so it can be
+ * passed in the context of any search on the thread.
+ */
+hc_arena *hc_arena_thread(void);
+
+/*
+ * Compiles a pattern x of length m into memory from an arena, instead of with malloc.  The pattern is freed with the
+ * arena, and must not be passed to hc_free().  Returns NULL if the pattern is shorter than HC_Q or memory cannot be
+ * allocated.
+ */
+hc_pattern *hc_compile_arena(hc_arena *a, const unsigned char *x, int m, hc_context *ctx);
+
+#endif
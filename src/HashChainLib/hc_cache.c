@@ -0,0 +1,273 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * A concurrent cache of compiled patterns, with lock-free lookups and sharded inserts.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hc_epoch.h"
+#include "hc_cache.h"
+
+struct hc_cache_entry {
+    hc_epoch_node retire;                       // Must be first: an evicted entry is retired through the epoch domain.
+    _Atomic(struct hc_cache_entry *) next;      // Next entry in the same bucket.
+    struct hc_cache_entry *clock_prev;          // Neighbours in the shard's CLOCK ring, protected by the shard lock.
+    struct hc_cache_entry *clock_next;
+    unsigned long long hash;                    // Hash of the pattern bytes.
+    size_t size;                                // Memory charged to the budget for this entry.
+    atomic_int refs;                            // One for the cache while it is linked in, plus one per acquire.
+    atomic_int referenced;                      // CLOCK reference bit, set by lookups.
+    hc_pattern *pattern;
+};
+
+typedef struct hc_cache_shard {
+    _Alignas(64) pthread_mutex_t lock;          // Serialises inserts and evictions in this shard.
+    _Atomic(hc_cache_entry *) *buckets;
+    unsigned long bucket_mask;
+    hc_cache_entry *clock_hand;                 // Next entry the CLOCK considers for eviction.
+    size_t bytes;
+    size_t budget;
+    unsigned long entries;
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong evictions;
+} hc_cache_shard;
+
+struct hc_cache {
+    hc_epoch epoch;
+    int shard_bits;
+    hc_cache_shard *shards;
+};
+
+/*
+ * FNV-1a hash of the pattern bytes.
+ */
+static unsigned long long hc_cache_hash(const unsigned char *x, int m) {
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < m; i++) h = (h ^ x[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static hc_cache_shard *hc_cache_shard_for(hc_cache *cache, unsigned long long hash) {
+    return cache->shards + (cache->shard_bits ? hash >> (64 - cache->shard_bits) : 0);
+}
+
+static void hc_cache_entry_unref(hc_cache_entry *entry) {
+    if (atomic_fetch_sub(&entry->refs, 1) == 1) {
+        hc_free(entry->pattern);
+        free(entry);
+    }
+}
+
+/*
+ * Drops the reference the cache held, once no reader can see the evicted entry any longer.
+ */
+static void hc_cache_entry_retired(hc_epoch_node *node) {
+    hc_cache_entry_unref((hc_cache_entry *) node);
+}
+
+/*
+ * Finds a pattern in a bucket.  Either called inside an epoch, or with the shard locked.
+ */
+static hc_cache_entry *hc_cache_find(hc_cache_shard *shard, unsigned long long hash, const unsigned char *x, int m) {
+    hc_cache_entry *entry = atomic_load_explicit(&shard->buckets[hash & shard->bucket_mask], memory_order_acquire);
+    while (entry) {
+        if (entry->hash == hash && entry->pattern->m == m && memcmp(entry->pattern->x, x, m) == 0) return entry;
+        entry = atomic_load_explicit(&entry->next, memory_order_acquire);
+    }
+    return NULL;
+}
+
+/*
+ * Evicts entries from a locked shard using CLOCK until an entry of the given size fits in its budget.
+ */
+static void hc_cache_evict(hc_cache *cache, hc_cache_shard *shard, size_t size) {
+    while (shard->clock_hand && shard->bytes + size > shard->budget) {
+        hc_cache_entry *victim = shard->clock_hand;
+        shard->clock_hand = victim->clock_next;
+
+        // Entries used since the hand last passed get a second chance.
+        if (atomic_load_explicit(&victim->referenced, memory_order_relaxed)) {
+            atomic_store_explicit(&victim->referenced, 0, memory_order_relaxed);
+            continue;
+        }
+
+        // Unlink it from its bucket.  Readers already on it can still follow its next pointer.
+        _Atomic(hc_cache_entry *) *link = &shard->buckets[victim->hash & shard->bucket_mask];
+        while (atomic_load_explicit(link, memory_order_relaxed) != victim) link = &atomic_load_explicit(link, memory_order_relaxed)->next;
+        atomic_store_explicit(link, atomic_load_explicit(&victim->next, memory_order_relaxed), memory_order_release);
+
+        // Unlink it from the CLOCK ring.
+        if (victim->clock_next == victim) {
+            shard->clock_hand = NULL;
+        }
+        else {
+            victim->clock_prev->clock_next = victim->clock_next;
+            victim->clock_next->clock_prev = victim->clock_prev;
+        }
+
+        shard->bytes -= victim->size;
+        shard->entries--;
+        atomic_fetch_add_explicit(&shard->evictions, 1, memory_order_relaxed);
+        hc_epoch_retire(&cache->epoch, &victim->retire, hc_cache_entry_retired);
+    }
+}
+
+hc_cache *hc_cache_create(size_t budget, int shard_bits) {
+    hc_cache *cache = calloc(1, sizeof(hc_cache));
+    if (!cache) return NULL;
+    const int nshards = 1 << shard_bits;
+    cache->shard_bits = shard_bits;
+    cache->shards = aligned_alloc(64, nshards * sizeof(hc_cache_shard));
+    if (!cache->shards) {
+        free(cache);
+        return NULL;
+    }
+    memset(cache->shards, 0, nshards * sizeof(hc_cache_shard));
+    hc_epoch_init(&cache->epoch);
+
+    // Size the buckets of each shard for the number of smallest patterns its budget can hold.
+    const size_t shard_budget = budget / nshards;
+    const size_t max_entries = shard_budget / (sizeof(hc_pattern) + sizeof(hc_cache_entry)) + 1;
+    unsigned long nbuckets = 16;
+    while (nbuckets < max_entries) nbuckets <<= 1;
+    for (int i = 0; i < nshards; i++) {
+        hc_cache_shard *shard = cache->shards + i;
+        shard->budget = shard_budget;
+        shard->bucket_mask = nbuckets - 1;
+        shard->buckets = calloc(nbuckets, sizeof(*shard->buckets));
+        if (!shard->buckets) {
+            hc_cache_destroy(cache);
+            return NULL;
+        }
+        // Only shards with buckets are destroyed, so the lock is initialised once they exist.
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+    return cache;
+}
+
+void hc_cache_destroy(hc_cache *cache) {
+    const int nshards = 1 << cache->shard_bits;
+    for (int i = 0; i < nshards; i++) {
+        hc_cache_shard *shard = cache->shards + i;
+        if (!shard->buckets) continue;
+        for (unsigned long b = 0; b <= shard->bucket_mask; b++) {
+            hc_cache_entry *entry = atomic_load(&shard->buckets[b]);
+            while (entry) {
+                hc_cache_entry *next = atomic_load(&entry->next);
+                hc_cache_entry_unref(entry);
+                entry = next;
+            }
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    hc_epoch_destroy(&cache->epoch);
+    free(cache->shards);
+    free(cache);
+}
+
+hc_cache_entry *hc_cache_acquire(hc_cache *cache, const unsigned char *x, int m) {
+    const unsigned long long hash = hc_cache_hash(x, m);
+    hc_cache_shard *shard = hc_cache_shard_for(cache, hash);
+
+    // Lock-free lookup.  Taking a reference inside the epoch is safe: the cache's own reference is not
+    // dropped until every reader which could see the entry has left its epoch.
+    hc_epoch_slot *slot = hc_epoch_enter(&cache->epoch);
+    hc_cache_entry *entry = hc_cache_find(shard, hash, x, m);
+    if (entry) {
+        atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+        if (!atomic_load_explicit(&entry->referenced, memory_order_relaxed))
+            atomic_store_explicit(&entry->referenced, 1, memory_order_relaxed);
+    }
+    hc_epoch_exit(&cache->epoch, slot);
+    if (entry) {
+        atomic_fetch_add_explicit(&shard->hits, 1, memory_order_relaxed);
+        return entry;
+    }
+    atomic_fetch_add_explicit(&shard->misses, 1, memory_order_relaxed);
+
+    // Compile outside the lock.
+    hc_pattern *pattern = hc_compile(x, m, NULL);
+    if (!pattern) return NULL;
+    entry = calloc(1, sizeof(hc_cache_entry));
+    if (!entry) {
+        hc_free(pattern);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->pattern = pattern;
+    entry->size = sizeof(hc_cache_entry) + hc_pattern_size(m);
+
+    // A pattern bigger than the whole shard budget is returned to the caller without being cached.
+    if (entry->size > shard->budget) {
+        atomic_init(&entry->refs, 1);
+        return entry;
+    }
+    atomic_init(&entry->refs, 2);
+
+    pthread_mutex_lock(&shard->lock);
+
+    // Another thread may have inserted the same pattern while we were compiling it.
+    hc_cache_entry *existing = hc_cache_find(shard, hash, x, m);
+    if (existing) {
+        atomic_fetch_add_explicit(&existing->refs, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&shard->lock);
+        hc_free(pattern);
+        free(entry);
+        return existing;
+    }
+
+    hc_cache_evict(cache, shard, entry->size);
+
+    // Add it to the CLOCK ring just behind the hand, so it is considered last.
+    if (shard->clock_hand) {
+        entry->clock_next = shard->clock_hand;
+        entry->clock_prev = shard->clock_hand->clock_prev;
+        entry->clock_prev->clock_next = entry;
+        shard->clock_hand->clock_prev = entry;
+    }
+    else {
+        entry->clock_next = entry->clock_prev = entry;
+        shard->clock_hand = entry;
+    }
+
+    // Publish it at the head of its bucket.
+    _Atomic(hc_cache_entry *) *bucket = &shard->buckets[hash & shard->bucket_mask];
+    atomic_init(&entry->next, atomic_load_explicit(bucket, memory_order_relaxed));
+    atomic_store_explicit(bucket, entry, memory_order_release);
+    shard->bytes += entry->size;
+    shard->entries++;
+
+    pthread_mutex_unlock(&shard->lock);
+
+    hc_epoch_reclaim(&cache->epoch);
+    return entry;
+}
+
+const hc_pattern *hc_cache_pattern(const hc_cache_entry *entry) {
+    return entry->pattern;
+}
+
+void hc_cache_release(hc_cache *cache, hc_cache_entry *entry) {
+    (void) cache;
+    hc_cache_entry_unref(entry);
+}
+
+void hc_cache_get_stats(hc_cache *cache, hc_cache_stats *stats) {
+    memset(stats, 0, sizeof(hc_cache_stats));
+    const int nshards = 1 << cache->shard_bits;
+    for (int i = 0; i < nshards; i++) {
+        hc_cache_shard *shard = cache->shards + i;
+        stats->hits += atomic_load_explicit(&shard->hits, memory_order_relaxed);
+        stats->misses += atomic_load_explicit(&shard->misses, memory_order_relaxed);
+        stats->evictions += atomic_load_explicit(&shard->evictions, memory_order_relaxed);
+        pthread_mutex_lock(&shard->lock);
+        stats->entries += shard->entries;
+        stats->bytes += shard->bytes;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
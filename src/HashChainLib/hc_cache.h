@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * A concurrent cache of compiled patterns.
+ *
+ * Patterns which are searched for repeatedly only need to be compiled once.  The cache maps the bytes of a pattern
+ * to its compiled hc_pattern.  Lookups take no locks: they run inside an epoch (see hc_epoch.h), so an entry being
+ * evicted at the same time is not freed under them.  Inserts lock only one of the cache's shards.  Each shard is
+ * held within its share of a memory budget by CLOCK eviction.
+ *
+ * The compile parameters HC_Q and HC_ALPHA are fixed when the library is built, so the key is just the pattern.
+ */
+
+#ifndef HC_CACHE_H
+#define HC_CACHE_H
+
+#include <stddef.h>
+#include "hashchain.h"
+
+typedef struct hc_cache hc_cache;
+typedef struct hc_cache_entry hc_cache_entry;
+
+/*
+ * Counts exported by the cache.
+ */
+typedef struct hc_cache_stats {
+    unsigned long hits;         // Lookups which found a compiled pattern.
+    unsigned long misses;       // Lookups which had to compile the pattern.
+    unsigned long evictions;    // Entries evicted to stay within the memory budget.
+    unsigned long entries;      // Entries currently in the cache.
+    size_t bytes;               // Memory currently used by the entries in the cache.
+} hc_cache_stats;
+
+/*
+ * Creates a cache which uses at most budget bytes for compiled patterns, split over 2^shard_bits shards.
+ * Returns NULL if memory cannot be allocated.
+ */
+hc_cache *hc_cache_create(size_t budget, int shard_bits);
+
+/*
+ * Destroys a cache.  No entries may still be acquired, and no other thread may be using the cache.
+ */
+void hc_cache_destroy(hc_cache *cache);
+
+/*
+ * Returns an entry for a pattern x of length m, compiling and inserting it if it is not already in the cache.
+ * The entry remains valid until it is released, even if it is evicted in the meantime.
+ * Returns NULL if the pattern cannot be compiled.
+ */
+hc_cache_entry *hc_cache_acquire(hc_cache *cache, const unsigned char *x, int m);
+
+/*
+ * Returns the compiled pattern for an acquired entry.
+ */
+const hc_pattern *hc_cache_pattern(const hc_cache_entry *entry);
+
+/*
+ * Releases an entry returned by hc_cache_acquire().
+ */
+void hc_cache_release(hc_cache *cache, hc_cache_entry *entry);
+
+/*
+ * Reads the hit, miss and eviction counts and the current size of the cache.
+ */
+void hc_cache_get_stats(hc_cache *cache, hc_cache_stats *stats);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Epoch-based reclamation.
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include "hc_epoch.h"
+
+void hc_epoch_init(hc_epoch *d) {
+    atomic_init(&d->epoch, 1);
+    for (int i = 0; i < HC_EPOCH_SLOTS; i++) atomic_init(&d->slots[i].state, 0);
+    atomic_init(&d->overflow, NULL);
+    pthread_mutex_init(&d->lock, NULL);
+    d->retired = NULL;
+}
+
+void hc_epoch_destroy(hc_epoch *d) {
+    hc_epoch_node *node = d->retired;
+    while (node) {
+        hc_epoch_node *next = node->next;
+        node->free_fn(node);
+        node = next;
+    }
+    d->retired = NULL;
+    hc_epoch_slot *slot = atomic_load(&d->overflow);
+    while (slot) {
+        hc_epoch_slot *next = slot->next;
+        free(slot);
+        slot = next;
+    }
+    atomic_store(&d->overflow, NULL);
+    pthread_mutex_destroy(&d->lock);
+}
+
+/*
+ * Claims a slot if it is free, recording the current epoch in it.
+ */
+static inline int hc_epoch_claim(hc_epoch *d, hc_epoch_slot *slot) {
+    unsigned long expected = 0;
+    const unsigned long state = (atomic_load(&d->epoch) << 1) | 1;
+    return atomic_compare_exchange_strong(&slot->state, &expected, state);
+}
+
+hc_epoch_slot *hc_epoch_enter(hc_epoch *d) {
+    // Start looking for a free slot at a position derived from the thread, so threads tend to keep their own slot.
+    unsigned long h = (unsigned long) pthread_self();
+    int slot = (int) ((h ^ (h >> 12)) % HC_EPOCH_SLOTS);
+    for (int i = 0; i < HC_EPOCH_SLOTS; i++) {
+        if (hc_epoch_claim(d, d->slots + slot)) return d->slots + slot;
+        if (++slot == HC_EPOCH_SLOTS) slot = 0;
+    }
+
+    // All the slots in the domain are in use: reuse a free overflow slot, or add a new one.
+    for (;;) {
+        for (hc_epoch_slot *extra = atomic_load(&d->overflow); extra; extra = extra->next) {
+            if (hc_epoch_claim(d, extra)) return extra;
+        }
+        hc_epoch_slot *extra = aligned_alloc(64, sizeof(hc_epoch_slot));
+        if (!extra) {
+            // Only if memory runs out does a reader wait for another to exit.
+            sched_yield();
+            continue;
+        }
+        // The slot is claimed before it is published, so reclaim sees its epoch as soon as it can see the slot.
+        atomic_init(&extra->state, (atomic_load(&d->epoch) << 1) | 1);
+        extra->next = atomic_load(&d->overflow);
+        while (!atomic_compare_exchange_weak(&d->overflow, &extra->next, extra));
+        return extra;
+    }
+}
+
+void hc_epoch_exit(hc_epoch *d, hc_epoch_slot *slot) {
+    (void) d;
+    atomic_store_explicit(&slot->state, 0, memory_order_release);
+}
+
+void hc_epoch_retire(hc_epoch *d, hc_epoch_node *node, void (*free_fn)(hc_epoch_node *)) {
+    node->free_fn = free_fn;
+    // Readers which entered at or before this epoch may still see the object; later readers cannot.
+    node->epoch = atomic_fetch_add(&d->epoch, 1);
+    pthread_mutex_lock(&d->lock);
+    node->next = d->retired;
+    d->retired = node;
+    pthread_mutex_unlock(&d->lock);
+}
+
+void hc_epoch_reclaim(hc_epoch *d) {
+    // Only objects retired before the slots are scanned can be freed: a reader which saw them was already in a slot.
+    // Of those, only the ones retired before the oldest epoch any reader is still inside can be freed.
+    unsigned long oldest = atomic_load(&d->epoch);
+    for (int i = 0; i < HC_EPOCH_SLOTS; i++) {
+        const unsigned long state = atomic_load(&d->slots[i].state);
+        if (state && (state >> 1) < oldest) oldest = state >> 1;
+    }
+    for (hc_epoch_slot *extra = atomic_load(&d->overflow); extra; extra = extra->next) {
+        const unsigned long state = atomic_load(&extra->state);
+        if (state && (state >> 1) < oldest) oldest = state >> 1;
+    }
+
+    // Unlink every object retired before that epoch, then free them outside the lock.
+    hc_epoch_node *done = NULL;
+    pthread_mutex_lock(&d->lock);
+    hc_epoch_node **link = &d->retired;
+    while (*link) {
+        hc_epoch_node *node = *link;
+        if (node->epoch < oldest) {
+            *link = node->next;
+            node->next = done;
+            done = node;
+        }
+        else {
+            link = &node->next;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    while (done) {
+        hc_epoch_node *next = done->next;
+        done->free_fn(done);
+        done = next;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Epoch-based reclamation.
+ *
+ * Readers enter an epoch before reading shared pointers, and exit it when they no longer use what they read.
+ * Entering and exiting never block: there is no limit on the number of readers at the same time.  Objects which
+ * have been unlinked from a shared structure are retired, and are only freed once every reader which could still
+ * see them has exited its epoch.
+ */
+
+#ifndef HC_EPOCH_H
+#define HC_EPOCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * The number of reader slots in the domain itself.  When they are all in use, further readers take a slot from
+ * an overflow list, which grows as needed and whose slots are reused.
+ */
+#ifndef HC_EPOCH_SLOTS
+#define HC_EPOCH_SLOTS 64
+#endif
+
+/*
+ * A node embedded in each object that can be retired.
+ */
+typedef struct hc_epoch_node {
+    struct hc_epoch_node *next;
+    unsigned long epoch;                         // The epoch in which the object was retired.
+    void (*free_fn)(struct hc_epoch_node *);     // Frees the object containing the node.
+} hc_epoch_node;
+
+/*
+ * A reader slot, on its own cache line so readers on different cores do not contend.
+ */
+typedef struct hc_epoch_slot {
+    _Alignas(64) atomic_ulong state;             // Zero if free, otherwise (epoch << 1) | 1.
+    struct hc_epoch_slot *next;                  // The next slot in the overflow list.
+} hc_epoch_slot;
+
+typedef struct hc_epoch {
+    atomic_ulong epoch;                          // The global epoch, advanced each time an object is retired.
+    hc_epoch_slot slots[HC_EPOCH_SLOTS];
+    _Atomic(hc_epoch_slot *) overflow;           // Extra slots, only ever added to until the domain is destroyed.
+    pthread_mutex_t lock;                        // Protects the retired list.
+    hc_epoch_node *retired;
+} hc_epoch;
+
+/*
+ * Initialises and destroys an epoch domain.  Destroying it frees every retired object, so no readers may remain.
+ */
+void hc_epoch_init(hc_epoch *d);
+void hc_epoch_destroy(hc_epoch *d);
+
+/*
+ * Enters and exits an epoch.  The slot returned by hc_epoch_enter() must be passed to hc_epoch_exit().
+ */
+hc_epoch_slot *hc_epoch_enter(hc_epoch *d);
+void hc_epoch_exit(hc_epoch *d, hc_epoch_slot *slot);
+
+/*
+ * Retires an object which is no longer reachable by new readers.  It is freed by a later hc_epoch_reclaim().
+ */
+void hc_epoch_retire(hc_epoch *d, hc_epoch_node *node, void (*free_fn)(hc_epoch_node *));
+
+/*
+ * Frees every retired object which no reader can still see.
+ */
+void hc_epoch_reclaim(hc_epoch *d);
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * A multi-process search farm over a single shared-memory text.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include "hc_farm.h"
+
+/*
+ * How long the coordinator sleeps between checks on its workers, in nanoseconds.
+ */
+#define HC_FARM_POLL_NS 1000000
+
+/*
+ * The queue segment: the patterns, handed out a batch at a time.
+ * It is followed by the pattern offsets, and the pattern bytes.
+ */
+typedef struct hc_farm_queue {
+    atomic_int next_batch;          // The next batch to hand out.
+    int nbatches;
+    int batch;
+    int npatterns;
+} hc_farm_queue;
+
+/*
+ * The results segment.  It is followed by the counts for each pattern, then the stored matches.
+ */
+typedef struct hc_farm_shared_results {
+    atomic_long nmatches;           // Matches found, which may be more than were stored.
+    long max_matches;
+} hc_farm_shared_results;
+
+/*
+ * Pointers into the attached segments.
+ */
+typedef struct hc_farm {
+    const unsigned char *text;
+    long n;
+    hc_farm_queue *queue;
+    long *offsets;                  // npatterns + 1 offsets of each pattern in the pattern bytes.
+    unsigned char *pattern_bytes;
+    hc_farm_shared_results *results;
+    long *counts;
+    hc_farm_match *matches;
+} hc_farm;
+
+typedef struct hc_farm_worker_match {
+    hc_farm *farm;
+    int pattern;
+} hc_farm_worker_match;
+
+static int hc_farm_record(void *data, long pos) {
+    hc_farm_worker_match *match = data;
+    hc_farm_shared_results *results = match->farm->results;
+    const long i = atomic_fetch_add(&results->nmatches, 1);
+    if (i < results->max_matches) {
+        match->farm->matches[i].pattern = match->pattern;
+        match->farm->matches[i].pos = pos;
+    }
+    return 0;
+}
+
+/*
+ * Creates a private shared memory segment and attaches it.  It is marked for removal at once, so it is
+ * destroyed when the coordinator and every worker has detached or exited, however they exit.
+ */
+static void *hc_farm_segment(size_t size) {
+    const int id = shmget(IPC_PRIVATE, size ? size : 1, IPC_CREAT | 0600);
+    if (id < 0) return NULL;
+    void *segment = shmat(id, NULL, 0);
+    shmctl(id, IPC_RMID, NULL);
+    return segment == (void *) -1 ? NULL : segment;
+}
+
+/*
+ * The body of a worker process: pin to a core, then search batches of patterns until the queue is empty.
+ */
+static void hc_farm_worker(hc_farm *farm, int slot) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(slot % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+
+    hc_farm_queue *queue = farm->queue;
+    for (;;) {
+        const int b = atomic_fetch_add(&queue->next_batch, 1);
+        if (b >= queue->nbatches) break;
+
+        const int last = (b + 1) * queue->batch < queue->npatterns ? (b + 1) * queue->batch : queue->npatterns;
+        for (int i = b * queue->batch; i < last; i++) {
+            hc_pattern *p = hc_compile(farm->pattern_bytes + farm->offsets[i], (int) (farm->offsets[i + 1] - farm->offsets[i]), NULL);
+            if (!p) continue;
+            hc_farm_worker_match match = { farm, i };
+            hc_context ctx = { hc_farm_record, &match, 0, 0, 0, NULL };
+            farm->counts[i] = hc_search(p, farm->text, farm->n, &ctx);
+            hc_free(p);
+        }
+    }
+}
+
+/*
+ * Starts a worker process in a slot.  Returns its pid, or -1 if it cannot be started.
+ */
+static pid_t hc_farm_spawn(hc_farm *farm, int slot) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        hc_farm_worker(farm, slot);
+        _exit(0);
+    }
+    return pid;
+}
+
+int hc_farm_search(const unsigned char *text, long n, const unsigned char *const *patterns, const int *lengths,
+                   int npatterns, int nworkers, int batch, long max_matches, hc_farm_results *results) {
+    memset(results, 0, sizeof(hc_farm_results));
+    if (batch < 1) batch = 1;
+    const int nbatches = (npatterns + batch - 1) / batch;
+    long total = 0;
+    for (int i = 0; i < npatterns; i++) total += lengths[i];
+
+    hc_farm farm;
+    farm.n = n;
+
+    // The text segment, created once and shared by every worker.
+    unsigned char *text_segment = hc_farm_segment(n);
+    if (!text_segment) return -1;
+    memcpy(text_segment, text, n);
+    farm.text = text_segment;
+
+    // The queue segment.
+    const size_t queue_size = sizeof(hc_farm_queue) + (npatterns + 1) * sizeof(long) + total;
+    unsigned char *queue_segment = hc_farm_segment(queue_size);
+    if (!queue_segment) {
+        shmdt(text_segment);
+        return -1;
+    }
+    farm.queue = (hc_farm_queue *) queue_segment;
+    farm.offsets = (long *) (farm.queue + 1);
+    farm.pattern_bytes = (unsigned char *) (farm.offsets + npatterns + 1);
+    atomic_init(&farm.queue->next_batch, 0);
+    farm.queue->nbatches = nbatches;
+    farm.queue->batch = batch;
+    farm.queue->npatterns = npatterns;
+    farm.offsets[0] = 0;
+    for (int i = 0; i < npatterns; i++) {
+        memcpy(farm.pattern_bytes + farm.offsets[i], patterns[i], lengths[i]);
+        farm.offsets[i + 1] = farm.offsets[i] + lengths[i];
+    }
+
+    // The results segment.  Counts start at -1, so patterns which are never searched are reported as failed.
+    const size_t results_size = sizeof(hc_farm_shared_results) + npatterns * sizeof(long) + max_matches * sizeof(hc_farm_match);
+    unsigned char *results_segment = hc_farm_segment(results_size);
+    if (!results_segment) {
+        shmdt(queue_segment);
+        shmdt(text_segment);
+        return -1;
+    }
+    farm.results = (hc_farm_shared_results *) results_segment;
+    farm.counts = (long *) (farm.results + 1);
+    farm.matches = (hc_farm_match *) (farm.counts + npatterns);
+    atomic_init(&farm.results->nmatches, 0);
+    farm.results->max_matches = max_matches;
+    for (int i = 0; i < npatterns; i++) farm.counts[i] = -1;
+
+    // Start the workers.  The segments are inherited over fork().
+    pid_t *pids = malloc(nworkers * sizeof(pid_t));
+    int running = 0;
+    for (int slot = 0; pids && slot < nworkers; slot++) {
+        pids[slot] = hc_farm_spawn(&farm, slot);
+        if (pids[slot] > 0) running++;
+    }
+
+    const int started = running > 0;
+
+    // Wait for them, polling only the farm's own workers, so no other child of the caller is reaped.  If one crashes,
+    // the rest of its batch is abandoned, and a replacement is started at once to carry on with the queue.
+    while (running > 0) {
+        int exited = 0;
+        for (int slot = 0; slot < nworkers; slot++) {
+            if (pids[slot] <= 0) continue;
+            int status;
+            const pid_t pid = waitpid(pids[slot], &status, WNOHANG);
+            if (pid == 0 || (pid < 0 && errno == EINTR)) continue;
+            exited++;
+            running--;
+            pids[slot] = -1;
+            if (pid < 0 || (WIFEXITED(status) && WEXITSTATUS(status) == 0)) continue;
+            if (atomic_load(&farm.queue->next_batch) < nbatches) {
+                pids[slot] = hc_farm_spawn(&farm, slot);
+                if (pids[slot] > 0) running++;
+            }
+        }
+        if (!exited && running > 0) {
+            const struct timespec pause = { 0, HC_FARM_POLL_NS };
+            nanosleep(&pause, NULL);
+        }
+    }
+    free(pids);
+
+    // Copy the results out of shared memory, dropping any partial matches from patterns whose worker crashed.
+    const long found = atomic_load(&farm.results->nmatches);
+    const long stored = found < max_matches ? found : max_matches;
+    results->counts = malloc(npatterns * sizeof(long));
+    results->matches = malloc((stored ? stored : 1) * sizeof(hc_farm_match));
+    int status = 0;
+    if (started && results->counts && results->matches) {
+        memcpy(results->counts, farm.counts, npatterns * sizeof(long));
+        for (long i = 0; i < stored; i++) {
+            if (farm.counts[farm.matches[i].pattern] >= 0) results->matches[results->nmatches++] = farm.matches[i];
+        }
+        for (int i = 0; i < npatterns; i++) if (farm.counts[i] > 0) results->dropped += farm.counts[i];
+        results->dropped -= results->nmatches;
+    }
+    else {
+        hc_farm_results_free(results);
+        status = -1;
+    }
+
+    shmdt(results_segment);
+    shmdt(queue_segment);
+    shmdt(text_segment);
+    return status;
+}
+
+void hc_farm_results_free(hc_farm_results *results) {
+    free(results->counts);
+    free(results->matches);
+    results->counts = NULL;
+    results->matches = NULL;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * A multi-process search farm over a single shared-memory text.
+ *
+ * Like SMART, the text is passed to the processes searching it in a System V shared memory segment, but here it
+ * is created once and shared by many worker processes.  Each worker is pinned to a core, takes batches of patterns
+ * from a queue in shared memory, and writes counts and match positions to a shared results segment.  A worker which
+ * crashes only loses the rest of the batch it was searching: the counts of those patterns are reported as -1, and a
+ * replacement worker is started to carry on with the rest of the queue.
+ */
+
+#ifndef HC_FARM_H
+#define HC_FARM_H
+
+#include "hashchain.h"
+
+/*
+ * A match of pattern number pattern at position pos in the text.
+ */
+typedef struct hc_farm_match {
+    int pattern;
+    long pos;
+} hc_farm_match;
+
+typedef struct hc_farm_results {
+    long *counts;               // Matches found for each pattern, or -1 if it could not be compiled or its worker crashed.
+    hc_farm_match *matches;     // The positions found, in no particular order.
+    long nmatches;              // Number of matches stored, at most the max_matches requested.
+    long dropped;               // Matches counted but not stored, because there were more than max_matches.
+} hc_farm_results;
+
+/*
+ * Searches a text of length n for npatterns patterns, using nworkers processes which take batch patterns at a time.
+ * Up to max_matches positions are stored in the results.  Returns 0 on success, or -1 if the shared memory segments
+ * or worker processes cannot be created.
+ */
+int hc_farm_search(const unsigned char *text, long n, const unsigned char *const *patterns, const int *lengths,
+                   int npatterns, int nworkers, int batch, long max_matches, hc_farm_results *results);
+
+/*
+ * Frees the arrays in a set of results.
+ */
+void hc_farm_results_free(hc_farm_results *results);
+
+#endif
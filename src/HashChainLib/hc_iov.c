@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Scatter-gather search of a text held in a list of segments.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hc_arena.h"
+#include "hc_iov.h"
+
+/*
+ * Stitched buffers up to this size are on the stack.
+ */
+#define HC_IOV_STACK 1024
+
+/*
+ * Translates positions in a segment or stitched buffer into offsets in the concatenated text.
+ */
+typedef struct hc_iov_match {
+    hc_context *ctx;
+    long base;
+    int stopped;
+} hc_iov_match;
+
+static int hc_iov_report(void *data, long pos) {
+    hc_iov_match *match = data;
+    return match->stopped = match->ctx->on_match(match->ctx->match_data, match->base + pos);
+}
+
+/*
+ * Searches a contiguous text y of length n, which starts at offset base in the concatenated text, adding its
+ * searching time to ctx->run_time if the search is timed.
+ */
+static long hc_iov_search(const hc_pattern *p, const unsigned char *y, long n, long base, hc_context *ctx, int *stopped) {
+    hc_iov_match match = { ctx, base, 0 };
+    hc_context inner = { ctx && ctx->on_match ? hc_iov_report : NULL, &match, ctx ? ctx->timed : 0, 0, 0,
+                         ctx ? ctx->arena : NULL };
+    const long count = hc_search(p, y, n, &inner);
+    if (ctx && ctx->timed) ctx->run_time += inner.run_time;
+    *stopped = match.stopped;
+    return count;
+}
+
+long hc_search_iov(const hc_pattern *p, const struct iovec *iov, int iovcnt, hc_context *ctx) {
+    const int m1 = p->m - 1;
+    hc_arena *arena = ctx ? ctx->arena : NULL;
+    const hc_arena_mark mark = arena ? hc_arena_get_mark(arena) : (hc_arena_mark) { NULL, 0 };
+    unsigned char stack[HC_IOV_STACK];
+    unsigned char *stitch = 2 * m1 <= HC_IOV_STACK ? stack : arena ? hc_arena_alloc(arena, 2 * m1) : malloc(2 * m1);
+    if (!stitch) return -1;
+    if (ctx && ctx->timed) ctx->run_time = 0;
+
+    long count = 0;
+    long offset = 0;            // Offset of the current segment in the concatenated text.
+    int history = 0;            // Number of bytes before the current segment held at the start of stitch, at most m - 1.
+    int stopped = 0;
+    for (int i = 0; i < iovcnt && !stopped; i++) {
+        const unsigned char *y = iov[i].iov_base;
+        const long n = iov[i].iov_len;
+        if (n == 0) continue;
+
+        // Windows which cross the seam: the bytes before it followed by up to m - 1 bytes of this segment.
+        // Every window in the stitched buffer crosses the seam, as neither side is as long as the pattern.
+        const int head = n < m1 ? (int) n : m1;
+        if (history > 0) {
+            memcpy(stitch + history, y, head);
+            count += hc_iov_search(p, stitch, history + head, offset - history, ctx, &stopped);
+            if (stopped) break;
+        }
+
+        // Windows inside this segment.
+        if (n >= p->m) {
+            count += hc_iov_search(p, y, n, offset, ctx, &stopped);
+        }
+
+        // Keep the last m - 1 bytes of the text so far for the next seam.
+        if (n >= m1) {
+            memcpy(stitch, y + n - m1, m1);
+            history = m1;
+        }
+        else {
+            const int keep = history + n > m1 ? m1 - (int) n : history;
+            memmove(stitch, stitch + history - keep, keep);
+            memcpy(stitch + keep, y, n);
+            history = keep + (int) n;
+        }
+        offset += n;
+    }
+
+    if (arena) hc_arena_rewind(arena, mark);
+    else if (stitch != stack) free(stitch);
+    return count;
+}
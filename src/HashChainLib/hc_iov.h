@@ -0,0 +1,23 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Scatter-gather search of a text held in a list of segments, without copying them into one buffer.
+ */
+
+#ifndef HC_IOV_H
+#define HC_IOV_H
+
+#include <sys/uio.h>
+#include "hashchain.h"
+
+/*
+ * Searches the text formed by concatenating iovcnt segments for a compiled pattern.
+ * The normal kernel runs inside each segment.  Only the windows which cross the seam at the start of a segment
+ * are searched in a stitched buffer of at most 2(m - 1) bytes: the m - 1 bytes before the seam and the first
+ * m - 1 bytes after it.  Positions passed to on_match are offsets in the concatenated text.  A timed search records
+ * the total searching time of every segment and stitched buffer in run_time.
+ * Returns the number of matches found, or -1 if memory for the stitched buffer cannot be allocated.
+ */
+long hc_search_iov(const hc_pattern *p, const struct iovec *iov, int iovcnt, hc_context *ctx);
+
+#endif
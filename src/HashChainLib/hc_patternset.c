@@ -0,0 +1,110 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Versioned pattern sets which can be swapped atomically while searches are running.
+ */
+
+#include <stdlib.h>
+#include "hc_patternset.h"
+
+static void hc_patternset_version_free(hc_patternset_version *v) {
+    hc_arena_destroy(v->arena);
+    free(v);
+}
+
+static void hc_patternset_version_retired(hc_epoch_node *node) {
+    hc_patternset_version_free((hc_patternset_version *) node);
+}
+
+hc_patternset_version *hc_patternset_build(const unsigned char *const *patterns, const int *lengths, int npatterns) {
+    hc_patternset_version *v = calloc(1, sizeof(hc_patternset_version));
+    if (!v) return NULL;
+
+    // Size the arena to hold everything in one block.
+    size_t size = npatterns * sizeof(hc_pattern *) + HC_ARENA_ALIGN;
+    for (int i = 0; i < npatterns; i++) {
+        if (lengths[i] >= HC_Q) size += hc_pattern_size(lengths[i]) + HC_ARENA_ALIGN;
+    }
+    v->arena = hc_arena_create(size);
+    v->patterns = v->arena ? hc_arena_alloc(v->arena, npatterns * sizeof(hc_pattern *)) : NULL;
+    if (!v->patterns) {
+        hc_arena_destroy(v->arena);
+        free(v);
+        return NULL;
+    }
+    v->npatterns = npatterns;
+    for (int i = 0; i < npatterns; i++) v->patterns[i] = hc_compile_arena(v->arena, patterns[i], lengths[i], NULL);
+    return v;
+}
+
+hc_patternset *hc_patternset_create(void) {
+    hc_patternset *s = malloc(sizeof(hc_patternset));
+    if (!s) return NULL;
+    hc_patternset_version *empty = hc_patternset_build(NULL, NULL, 0);
+    if (!empty) {
+        free(s);
+        return NULL;
+    }
+    hc_epoch_init(&s->epoch);
+    atomic_init(&s->published, 0);
+    atomic_init(&s->current, empty);
+    return s;
+}
+
+void hc_patternset_destroy(hc_patternset *s) {
+    hc_patternset_version_free(atomic_load(&s->current));
+    hc_epoch_destroy(&s->epoch);
+    free(s);
+}
+
+void hc_patternset_publish(hc_patternset *s, hc_patternset_version *v) {
+    v->version = atomic_fetch_add(&s->published, 1) + 1;
+    hc_patternset_version *old = atomic_exchange(&s->current, v);
+    hc_epoch_retire(&s->epoch, &old->retire, hc_patternset_version_retired);
+    hc_epoch_reclaim(&s->epoch);
+}
+
+void hc_patternset_reclaim(hc_patternset *s) {
+    hc_epoch_reclaim(&s->epoch);
+}
+
+const hc_patternset_version *hc_patternset_pin(hc_patternset *s, hc_patternset_hold *pin) {
+    pin->slot = hc_epoch_enter(&s->epoch);
+    pin->version = atomic_load(&s->current);
+    return pin->version;
+}
+
+void hc_patternset_unpin(hc_patternset *s, hc_patternset_hold *pin) {
+    hc_epoch_exit(&s->epoch, pin->slot);
+    pin->version = NULL;
+}
+
+/*
+ * Adds the pattern number to the matches reported for each pattern in the set.
+ */
+typedef struct hc_patternset_match {
+    hc_patternset_match_fn *on_match;
+    void *data;
+    int pattern;
+    int stopped;
+} hc_patternset_match;
+
+static int hc_patternset_report(void *data, long pos) {
+    hc_patternset_match *match = data;
+    return match->stopped = match->on_match(match->data, match->pattern, pos);
+}
+
+long hc_patternset_search(hc_patternset *s, const unsigned char *y, long n, hc_patternset_match_fn *on_match, void *data) {
+    hc_patternset_hold pin;
+    const hc_patternset_version *v = hc_patternset_pin(s, &pin);
+    long count = 0;
+    hc_patternset_match match = { on_match, data, 0, 0 };
+    hc_context ctx = { on_match ? hc_patternset_report : NULL, &match, 0, 0, 0, NULL };
+    for (int i = 0; i < v->npatterns && !match.stopped; i++) {
+        if (!v->patterns[i]) continue;
+        match.pattern = i;
+        count += hc_search(v->patterns[i], y, n, &ctx);
+    }
+    hc_patternset_unpin(s, &pin);
+    return count;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Versioned pattern sets which can be swapped atomically while searches are running.
+ *
+ * A new version of a pattern set is compiled in the background, then published with a single atomic pointer swap.
+ * Searches pin the current version for as long as they use it, which never blocks.  The old version is reclaimed
+ * once no search still holds it, using epoch-based reclamation (see hc_epoch.h), so updating the patterns causes
+ * no pauses and does not need traffic to be drained first.
+ */
+
+#ifndef HC_PATTERNSET_H
+#define HC_PATTERNSET_H
+
+#include "hashchain.h"
+#include "hc_arena.h"
+#include "hc_epoch.h"
+
+/*
+ * An immutable, compiled version of a pattern set.
+ */
+typedef struct hc_patternset_version {
+    hc_epoch_node retire;       // Must be first: a replaced version is retired through the epoch domain.
+    unsigned long version;      // Set when published, starting at 1.
+    int npatterns;
+    hc_pattern **patterns;      // NULL for any pattern which could not be compiled.
+    hc_arena *arena;            // Holds the patterns, one after another, and the array of them.
+} hc_patternset_version;
+
+typedef struct hc_patternset {
+    hc_epoch epoch;
+    _Atomic(hc_patternset_version *) current;
+    atomic_ulong published;     // Number of versions published so far.
+} hc_patternset;
+
+/*
+ * A pin on the current version, held by a search.
+ */
+typedef struct hc_patternset_hold {
+    hc_epoch_slot *slot;
+    const hc_patternset_version *version;
+} hc_patternset_hold;
+
+/*
+ * Called for each match of pattern number pattern at position pos.  Return non-zero to stop the search.
+ */
+typedef int hc_patternset_match_fn(void *data, int pattern, long pos);
+
+/*
+ * Creates and destroys a pattern set handle.  It starts with an empty version.  Destroying it frees every version,
+ * so no search may still be running.  Returns NULL if memory cannot be allocated.
+ */
+hc_patternset *hc_patternset_create(void);
+void hc_patternset_destroy(hc_patternset *s);
+
+/*
+ * Compiles a new version from npatterns patterns, without publishing it.  The patterns are compiled into a single
+ * block of memory, in order.  Returns NULL if memory cannot be allocated.
+ */
+hc_patternset_version *hc_patternset_build(const unsigned char *const *patterns, const int *lengths, int npatterns);
+
+/*
+ * Publishes a version built by hc_patternset_build(), atomically replacing the current one, and retires the old one.
+ * Only one thread should publish at a time.
+ */
+void hc_patternset_publish(hc_patternset *s, hc_patternset_version *v);
+
+/*
+ * Frees versions which have been replaced and are no longer pinned by any search.  Called by each publish,
+ * and can also be called periodically by the thread which publishes.
+ */
+void hc_patternset_reclaim(hc_patternset *s);
+
+/*
+ * Pins the current version, which stays valid until it is unpinned, even if a new version is published meanwhile.
+ */
+const hc_patternset_version *hc_patternset_pin(hc_patternset *s, hc_patternset_hold *pin);
+void hc_patternset_unpin(hc_patternset *s, hc_patternset_hold *pin);
+
+/*
+ * Searches a text y of length n for every pattern of the current version, pinning it for the duration of the search.
+ * Returns the total number of matches found.
+ */
+long hc_patternset_search(hc_patternset *s, const unsigned char *y, long n, hc_patternset_match_fn *on_match, void *data);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Pipelined search, with filtering and verification on different threads.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hc_arena.h"
+#include "hc_pipe.h"
+
+/*
+ * A batch of candidates.  Batch number s uses block s % HC_PIPE_BLOCKS, and is verified by thread s % nverifiers.
+ */
+typedef struct hc_pipe_block {
+    _Alignas(64) atomic_long ready;             // s + 1 once the filter has filled batch s.
+    atomic_long verified;                       // s + 1 once batch s has been verified.
+    int ncandidates;
+    long candidates[HC_PIPE_BATCH];             // Start positions of candidate windows.
+    unsigned char matched[HC_PIPE_BATCH];       // Set by the verifier for each candidate which matches.
+} hc_pipe_block;
+
+typedef struct hc_pipe {
+    const hc_pattern *p;
+    const unsigned char *y;
+    int nverifiers;
+    hc_pipe_block *blocks;
+    atomic_long total;                          // Number of batches, set when filtering has finished; -1 until then.
+} hc_pipe;
+
+typedef struct hc_pipe_verifier {
+    hc_pipe *pipe;
+    int id;
+    pthread_t thread;
+} hc_pipe_verifier;
+
+/*
+ * Spins briefly, then yields, while waiting for another thread.
+ */
+static inline void hc_pipe_wait(int *spins) {
+    if (++*spins > 64) sched_yield();
+}
+
+static void *hc_pipe_verify(void *arg) {
+    hc_pipe_verifier *verifier = arg;
+    hc_pipe *pipe = verifier->pipe;
+    const unsigned char *x = pipe->p->x;
+    const int m = pipe->p->m;
+    for (long s = verifier->id; ; s += pipe->nverifiers) {
+        hc_pipe_block *block = pipe->blocks + s % HC_PIPE_BLOCKS;
+
+        // Wait for the batch to be filled, or for filtering to finish without it.
+        int spins = 0;
+        while (atomic_load_explicit(&block->ready, memory_order_acquire) != s + 1) {
+            const long total = atomic_load_explicit(&pipe->total, memory_order_acquire);
+            if (total >= 0 && s >= total) return NULL;
+            hc_pipe_wait(&spins);
+        }
+
+        for (int i = 0; i < block->ncandidates; i++) {
+            block->matched[i] = memcmp(pipe->y + block->candidates[i], x, m) == 0;
+        }
+        atomic_store_explicit(&block->verified, s + 1, memory_order_release);
+    }
+}
+
+/*
+ * Waits for batch s to be verified, and reports its matches in order.  Returns the number of matches in it.
+ */
+static long hc_pipe_report(hc_pipe *pipe, long s, hc_context *ctx, int *stopped) {
+    hc_pipe_block *block = pipe->blocks + s % HC_PIPE_BLOCKS;
+    int spins = 0;
+    while (atomic_load_explicit(&block->verified, memory_order_acquire) != s + 1) hc_pipe_wait(&spins);
+    long count = 0;
+    for (int i = 0; i < block->ncandidates; i++) {
+        if (block->matched[i] && !*stopped) {
+            count++;
+            if (ctx && ctx->on_match && ctx->on_match(ctx->match_data, block->candidates[i])) *stopped = 1;
+        }
+    }
+    return count;
+}
+
+/*
+ * Returns the time from a monotonic clock in milliseconds.
+ */
+static double hc_pipe_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec * 1e-6;
+}
+
+long hc_search_pipelined(const hc_pattern *p, const unsigned char *y, long n, int nverifiers, hc_context *ctx) {
+    if (nverifiers < 1) return hc_search(p, y, n, ctx);
+    const double start_time = ctx && ctx->timed ? hc_pipe_time_ms() : 0;
+
+    hc_pipe pipe;
+    pipe.p = p;
+    pipe.y = y;
+    pipe.nverifiers = nverifiers;
+    atomic_init(&pipe.total, -1);
+    hc_arena *arena = ctx ? ctx->arena : NULL;
+    const hc_arena_mark mark = arena ? hc_arena_get_mark(arena) : (hc_arena_mark) { NULL, 0 };
+    hc_pipe_verifier *verifiers;
+    if (arena) {
+        pipe.blocks = hc_arena_alloc(arena, HC_PIPE_BLOCKS * sizeof(hc_pipe_block));
+        verifiers = hc_arena_alloc(arena, nverifiers * sizeof(hc_pipe_verifier));
+    }
+    else {
+        pipe.blocks = aligned_alloc(64, HC_PIPE_BLOCKS * sizeof(hc_pipe_block));
+        verifiers = malloc(nverifiers * sizeof(hc_pipe_verifier));
+    }
+    if (!pipe.blocks || !verifiers) {
+        if (arena) hc_arena_rewind(arena, mark);
+        else {
+            free(pipe.blocks);
+            free(verifiers);
+        }
+        return -1;
+    }
+    for (int i = 0; i < HC_PIPE_BLOCKS; i++) {
+        atomic_init(&pipe.blocks[i].ready, 0);
+        atomic_init(&pipe.blocks[i].verified, 0);
+    }
+    int started = 0;
+    for (; started < nverifiers; started++) {
+        verifiers[started].pipe = &pipe;
+        verifiers[started].id = started;
+        if (pthread_create(&verifiers[started].thread, NULL, hc_pipe_verify, verifiers + started)) break;
+    }
+
+    long count = 0;
+    long batch = 0;             // The batch being filled.
+    long reported = 0;          // The next batch to report.
+    int stopped = 0;
+    if (started == nverifiers) {
+        const unsigned int *B = p->B;
+        const int m = p->m;
+        const unsigned int Hm = p->Hm;
+        const int MQ1 = m - HC_Q + 1;
+        unsigned int H, V;
+        hc_pipe_block *block = pipe.blocks;
+        block->ncandidates = 0;
+        long pos = m - 1;
+        // While within the search text:
+        while (pos < n && !stopped) {
+
+            // If there is a bit set for the hash:
+            H = hc_chain_hash(y, pos);
+            V = B[H & HC_TABLE_MASK];
+            if (V) {
+
+                // Look at the chain of q-grams that precede it:
+                const long end_second_qgram_pos = pos - m + HC_Q2;
+                while (pos >= end_second_qgram_pos)
+                {
+                    pos -= HC_Q;
+                    H = hc_chain_hash(y, pos);
+                    // If we have no match for this chain q-gram, break out and go around the main loop again:
+                    if (!(V & HC_LINK_HASH(H))) goto shift;
+                    V = B[H & HC_TABLE_MASK];
+                }
+
+                // Matched the chain all the way back to the start - pass on a candidate if the hash Hm matches as well:
+                pos = end_second_qgram_pos - HC_Q;
+                if (H == Hm) {
+                    block->candidates[block->ncandidates++] = pos - HC_END_FIRST_QGRAM;
+                    if (block->ncandidates == HC_PIPE_BATCH) {
+                        atomic_store_explicit(&block->ready, batch + 1, memory_order_release);
+                        batch++;
+
+                        // Report the oldest batch if its block is needed for the next one.
+                        if (batch - reported == HC_PIPE_BLOCKS) count += hc_pipe_report(&pipe, reported++, ctx, &stopped);
+                        block = pipe.blocks + batch % HC_PIPE_BLOCKS;
+                        block->ncandidates = 0;
+                    }
+                }
+            }
+
+            // Go around the main loop looking for another hash, incrementing the pos by MQ1.
+            shift:
+            pos += MQ1;
+        }
+
+        // Pass on the last partial batch, and report everything not yet reported.
+        if (block->ncandidates) atomic_store_explicit(&block->ready, ++batch, memory_order_release);
+        atomic_store_explicit(&pipe.total, batch, memory_order_release);
+        while (reported < batch) count += hc_pipe_report(&pipe, reported++, ctx, &stopped);
+    }
+    else {
+        atomic_store_explicit(&pipe.total, 0, memory_order_release);
+        count = -1;
+    }
+
+    for (int i = 0; i < started; i++) pthread_join(verifiers[i].thread, NULL);
+    if (arena) hc_arena_rewind(arena, mark);
+    else {
+        free(verifiers);
+        free(pipe.blocks);
+    }
+    if (ctx && ctx->timed) ctx->run_time = hc_pipe_time_ms() - start_time;
+    return count;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Pipelined search, with filtering and verification on different threads.
+ *
+ * On match-dense data verification can take longer than filtering.  Here the calling thread runs the HashChain
+ * filter and passes batches of candidate positions to one or more verifier threads, which confirm them with memcmp.
+ * Each batch has a single producer and a single consumer, and is handed over without locks.  The calling thread
+ * also reports the verified matches to on_match, in the order they occur in the text.
+ */
+
+#ifndef HC_PIPE_H
+#define HC_PIPE_H
+
+#include "hashchain.h"
+
+/*
+ * The number of candidate positions in a batch, and the number of batches in flight.
+ */
+#ifndef HC_PIPE_BATCH
+#define HC_PIPE_BATCH  256
+#endif
+#ifndef HC_PIPE_BLOCKS
+#define HC_PIPE_BLOCKS 64
+#endif
+
+/*
+ * Searches a text y of length n for a compiled pattern, verifying candidates on nverifiers threads.
+ * Matches are reported to on_match in text order, from the calling thread.  Returns the number of matches found,
+ * or -1 if the verifier threads cannot be started.  Starting threads has a cost, so this is only worth using on
+ * large texts.  A timed search records the time of the whole call in run_time, including starting the threads.
+ */
+long hc_search_pipelined(const hc_pattern *p, const unsigned char *y, long n, int nverifiers, hc_context *ctx);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Search of the live window of a circular buffer.
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/mman.h>
+#include "hc_iov.h"
+#include "hc_ring.h"
+
+/*
+ * Translates offsets in the live data into free-running ring indices.
+ */
+typedef struct hc_ring_match {
+    hc_context *ctx;
+    unsigned long tail;
+} hc_ring_match;
+
+static int hc_ring_report(void *data, long pos) {
+    hc_ring_match *match = data;
+    return match->ctx->on_match(match->ctx->match_data, (long) (match->tail + pos));
+}
+
+long hc_search_ring(const hc_pattern *p, const unsigned char *ring, size_t size,
+                    unsigned long tail, unsigned long head, hc_context *ctx) {
+    const size_t start = tail & (size - 1);
+    const size_t live = head - tail;
+
+    // Both runs are searched as the segments of a scatter-gather list, which stitches the wrap region.
+    struct iovec runs[2];
+    int nruns = 1;
+    runs[0].iov_base = (void *) (ring + start);
+    if (start + live <= size) {
+        runs[0].iov_len = live;
+    }
+    else {
+        runs[0].iov_len = size - start;
+        runs[1].iov_base = (void *) ring;
+        runs[1].iov_len = live - (size - start);
+        nruns = 2;
+    }
+
+    hc_ring_match match = { ctx, tail };
+    hc_context inner = { ctx && ctx->on_match ? hc_ring_report : NULL, &match, ctx ? ctx->timed : 0, 0, 0,
+                         ctx ? ctx->arena : NULL };
+    const long count = hc_search_iov(p, runs, nruns, &inner);
+    if (ctx && ctx->timed) ctx->run_time = inner.run_time;
+    return count;
+}
+
+unsigned char *hc_ring_map(size_t size) {
+#ifdef __linux__
+    int fd = memfd_create("hc_ring", 0);
+    if (fd < 0) return NULL;
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Reserve twice the size, then map the same memory over each half.
+    unsigned char *ring = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (mmap(ring, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(ring + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(ring, 2 * size);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    return ring;
+#else
+    (void) size;
+    return NULL;
+#endif
+}
+
+void hc_ring_unmap(unsigned char *ring, size_t size) {
+    munmap(ring, 2 * size);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Search of the live window of a circular buffer, without copying it.
+ */
+
+#ifndef HC_RING_H
+#define HC_RING_H
+
+#include <stddef.h>
+#include "hashchain.h"
+
+/*
+ * Searches the live data of a ring buffer of size bytes, a power of two.  The live data runs from tail up to head,
+ * which are free-running indices masked by size - 1, so head - tail is at most size.  If the live data wraps,
+ * the kernel runs on the two contiguous runs and only the windows crossing the wrap are searched in a stitched
+ * buffer of at most 2(m - 1) bytes.  Positions passed to on_match are free-running indices, like tail and head.
+ * Returns the number of matches found, or -1 if memory for the stitched buffer cannot be allocated.
+ */
+long hc_search_ring(const hc_pattern *p, const unsigned char *ring, size_t size,
+                    unsigned long tail, unsigned long head, hc_context *ctx);
+
+/*
+ * Maps a double-mapped (magic) ring buffer of size bytes, a multiple of the page size.  The size bytes after the
+ * buffer map the same memory again, so live data which wraps is contiguous in memory, and can be searched with
+ * hc_search() at ring + (tail & (size - 1)) for head - tail bytes.  Returns NULL if it cannot be mapped,
+ * or on systems other than Linux.
+ */
+unsigned char *hc_ring_map(size_t size);
+
+/*
+ * Unmaps a ring buffer returned by hc_ring_map().
+ */
+void hc_ring_unmap(unsigned char *ring, size_t size);
+
+#endif
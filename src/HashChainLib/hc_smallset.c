@@ -0,0 +1,139 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Lock-step search of a small set of patterns, with a table for each pattern.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hc_smallset.h"
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+hc_smallset *hc_smallset_create(const unsigned char *const *patterns, const int *lengths, int npatterns) {
+    if (npatterns < 1 || npatterns > HC_SMALLSET_MAX) return NULL;
+    size_t total = 0;
+    for (int i = 0; i < npatterns; i++) {
+        if (lengths[i] < HC_Q) return NULL;  // have to be at least Q in length to search.
+        total += lengths[i];
+    }
+
+    int stride = 1;
+    while (stride < npatterns) stride <<= 1;
+
+    // The tables and the copies of the patterns are stored in the same allocation, after the struct.
+    const size_t header = (sizeof(hc_smallset) + 63) & ~(size_t) 63;
+    const size_t table = (size_t) HC_ASIZE * stride * sizeof(unsigned int);
+    hc_smallset *s = aligned_alloc(64, (header + table + total + 63) & ~(size_t) 63);
+    unsigned int *dense = malloc(HC_ASIZE * sizeof(unsigned int));
+    if (!s || !dense) {
+        free(s);
+        free(dense);
+        return NULL;
+    }
+    s->npatterns = npatterns;
+    s->stride = stride;
+    s->B = (unsigned int *) ((unsigned char *) s + header);
+    memset(s->B, 0, table);
+
+    // Build the table of each pattern on its own, then interleave it with the others.
+    unsigned char *copy = (unsigned char *) s->B + table;
+    s->min_m = lengths[0];
+    for (int i = 0; i < npatterns; i++) {
+        const int m = lengths[i];
+        memcpy(copy, patterns[i], m);
+        s->x[i] = copy;
+        s->m[i] = m;
+        s->min_m = MIN(s->min_m, m);
+        s->Hm[i] = hc_preprocessing(copy, m, dense);
+        for (int bucket = 0; bucket < HC_ASIZE; bucket++) s->B[bucket * stride + i] = dense[bucket];
+        copy += m;
+    }
+    free(dense);
+    return s;
+}
+
+void hc_smallset_free(hc_smallset *s) {
+    free(s);
+}
+
+/*
+ * Follows the chain of pattern i back from the window ending at pos, whose q-gram has hash H and entry V,
+ * verifying the window if the whole chain matches.  Returns the position of the next window this pattern needs
+ * examined, as the single pattern kernel would move on to, or -1 if on_match asks to stop.
+ */
+static inline __attribute__((always_inline))
+long hc_smallset_chain(const hc_smallset *s, int i, const unsigned char *y, long pos, unsigned int H, unsigned int V,
+                       int stride, long *count, hc_smallset_match_fn *on_match, void *data) {
+    const unsigned int *B = s->B + i;
+    const int m = s->m[i];
+    const int MQ1 = m - HC_Q + 1;
+    if (pos < m - 1) return m - 1;    // The window would start before the text.
+
+    // Look at the chain of q-grams that precede it:
+    const long window_end_pos = pos;
+    const long end_second_qgram_pos = pos - m + HC_Q2;
+    while (pos >= end_second_qgram_pos)
+    {
+        pos -= HC_Q;
+        H = hc_chain_hash(y, pos);
+        // If we have no match for this chain q-gram, the window after the shift from here is next:
+        if (!(V & HC_LINK_HASH(H))) return pos + MQ1;
+        V = B[(H & HC_TABLE_MASK) * stride];
+    }
+
+    // Matched the chain all the way back to the start - verify the pattern if the hash Hm matches as well:
+    const long start = window_end_pos - m + 1;
+    if (H == s->Hm[i] && memcmp(y + start, s->x[i], m) == 0) {
+        (*count)++;
+        if (on_match && on_match(data, i, start)) return -1;
+    }
+    return window_end_pos + 1;
+}
+
+/*
+ * The lock-step kernel for a given stride, which the compiler specialises so that the probe of every table for
+ * a bucket is a few vector instructions on one cache line.
+ */
+static inline __attribute__((always_inline))
+long hc_smallset_kernel(const hc_smallset *s, const unsigned char *y, long n, int stride,
+                        hc_smallset_match_fn *on_match, void *data) {
+    const int npatterns = s->npatterns;
+    const int min_shift = s->min_m - HC_Q + 1;
+    long count = 0;
+    long pos = s->min_m - 1;
+    // While within the search text:
+    while (pos < n) {
+
+        // Look up the hash in every table at once:
+        const unsigned int H = hc_chain_hash(y, pos);
+        const unsigned int *V = s->B + (H & HC_TABLE_MASK) * stride;
+        unsigned int any = 0;
+        for (int i = 0; i < stride; i++) any |= V[i];
+
+        // Patterns with no bit set for the hash can all shift by at least the smallest shift.  Any which do have
+        // a bit set follow their own chain, and the text moves on to the nearest window any pattern needs next.
+        long next = pos + min_shift;
+        if (any) {
+            for (int i = 0; i < npatterns; i++) {
+                if (!V[i]) continue;
+                const long next_i = hc_smallset_chain(s, i, y, pos, H, V[i], stride, &count, on_match, data);
+                if (next_i < 0) return count;
+                next = MIN(next, next_i);
+            }
+        }
+        pos = next;
+    }
+    return count;
+}
+
+long hc_smallset_search(const hc_smallset *s, const unsigned char *y, long n, hc_smallset_match_fn *on_match,
+                        void *data) {
+    switch (s->stride) {
+        case 1:  return hc_smallset_kernel(s, y, n, 1, on_match, data);
+        case 2:  return hc_smallset_kernel(s, y, n, 2, on_match, data);
+        case 4:  return hc_smallset_kernel(s, y, n, 4, on_match, data);
+        case 8:  return hc_smallset_kernel(s, y, n, 8, on_match, data);
+        default: return hc_smallset_kernel(s, y, n, 16, on_match, data);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Lock-step search of a small set of patterns, with a table for each pattern.
+ *
+ * Searching for a few patterns with a separate pass for each reads the text once per pattern, and merging them into
+ * a single table weakens the filter.  A small set keeps a HashChain table for each pattern, interleaved so that the
+ * entries of every pattern for the same bucket are next to each other, in one cache line for up to 16 patterns.
+ * The text is read once: the hash of each q-gram examined is computed once and looked up in every table at the
+ * same time, and only patterns with an entry set go on to check their own chain.  The text moves on by the
+ * smallest shift any pattern allows.
+ */
+
+#ifndef HC_SMALLSET_H
+#define HC_SMALLSET_H
+
+#include "hashchain.h"
+
+/*
+ * The largest number of patterns in a small set.
+ */
+#define HC_SMALLSET_MAX 16
+
+/*
+ * Called for each match of pattern number pattern at position pos.  Return non-zero to stop the search.
+ */
+typedef int hc_smallset_match_fn(void *data, int pattern, long pos);
+
+/*
+ * A compiled small set of patterns.  It is never modified after hc_smallset_create() returns, so it can be shared
+ * between threads.
+ */
+typedef struct hc_smallset {
+    int npatterns;
+    int stride;                                 // Entries in each bucket: npatterns rounded up to a power of two.
+    int min_m;                                  // Length of the shortest pattern.
+    int m[HC_SMALLSET_MAX];                     // Length of each pattern.
+    unsigned int Hm[HC_SMALLSET_MAX];           // Hash value of the first q-gram of each pattern, as in hc_pattern.
+    const unsigned char *x[HC_SMALLSET_MAX];    // Copy of each pattern, stored after the tables.
+    unsigned int *B;                            // The tables, with the entry of pattern i for bucket b at B[b * stride + i].
+} hc_smallset;
+
+/*
+ * Compiles a small set of npatterns patterns, from 1 to HC_SMALLSET_MAX.  Returns NULL if there are too many or too
+ * few patterns, any pattern is shorter than HC_Q, or memory cannot be allocated.
+ */
+hc_smallset *hc_smallset_create(const unsigned char *const *patterns, const int *lengths, int npatterns);
+
+/*
+ * Frees a small set.
+ */
+void hc_smallset_free(hc_smallset *s);
+
+/*
+ * Searches a text y of length n for every pattern in the set, reading it once.  Matches are reported in the order
+ * of their end positions, and in pattern order for matches which end at the same position.
+ * Returns the total number of matches found.  If on_match asks to stop, returns the number found so far.
+ */
+long hc_smallset_search(const hc_smallset *s, const unsigned char *y, long n, hc_smallset_match_fn *on_match,
+                        void *data);
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Compact storage of compiled patterns, expanded on demand into a reusable scratch area.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hc_sparse.h"
+
+/*
+ * A non-zero entry of the table, while a sparse pattern is being built.
+ */
+typedef struct hc_sparse_entry {
+    unsigned int bucket;
+    unsigned int bits;
+} hc_sparse_entry;
+
+/*
+ * The buckets are stored after the bits, and the pattern after the buckets.
+ */
+static inline hc_text_hash *hc_sparse_buckets(const hc_sparse_pattern *sp) {
+    return (hc_text_hash *) (sp->bits + sp->nentries);
+}
+
+static inline unsigned char *hc_sparse_x(const hc_sparse_pattern *sp) {
+    return (unsigned char *) (hc_sparse_buckets(sp) + sp->nentries);
+}
+
+static int hc_sparse_entry_cmp(const void *a, const void *b) {
+    const unsigned int bucket_a = ((const hc_sparse_entry *) a)->bucket;
+    const unsigned int bucket_b = ((const hc_sparse_entry *) b)->bucket;
+    return (bucket_a > bucket_b) - (bucket_a < bucket_b);
+}
+
+/*
+ * Zeroes the entries of the pattern held in the scratch area.  Every entry which the preprocessing sets is the
+ * bucket of one of the q-grams of the pattern, so only those need to be cleared.
+ */
+static void hc_scratch_clear(hc_scratch *s) {
+    hc_pattern *p = s->p;
+    for (int pos = HC_END_FIRST_QGRAM; pos < p->m; pos++) {
+        p->B[hc_chain_hash(p->x, pos) & HC_TABLE_MASK] = 0;
+    }
+    p->m = 0;
+}
+
+/*
+ * Makes sure the scratch area has room for a pattern of length m.  It must hold no pattern.
+ * Returns non-zero if memory cannot be allocated.
+ */
+static int hc_scratch_reserve(hc_scratch *s, int m) {
+    if (m <= s->max_m) return 0;
+    const int max_m = s->p && m < 2 * s->max_m ? 2 * s->max_m : m;
+
+    // As in hc_compile(), the KMP table and the pattern are stored after the hash table.
+    // The hash table is all zeroes, and is kept when the area grows.
+    const int first = s->p == NULL;
+    hc_pattern *p = realloc(s->p, hc_pattern_size(max_m));
+    if (!p) return 1;
+    if (first) {
+        memset(p->B, 0, HC_ASIZE * sizeof(unsigned int));
+        p->m = 0;
+    }
+    p->kmp = (int *) (p + 1);
+    p->x = (unsigned char *) (p->kmp + max_m + 1);
+    s->p = p;
+    s->max_m = max_m;
+    return 0;
+}
+
+hc_scratch *hc_scratch_create(void) {
+    hc_scratch *s = malloc(sizeof(hc_scratch));
+    if (!s) return NULL;
+    s->p = NULL;
+    s->max_m = -1;
+    if (hc_scratch_reserve(s, HC_Q2)) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void hc_scratch_destroy(hc_scratch *s) {
+    if (!s) return;
+    free(s->p);
+    free(s);
+}
+
+hc_sparse_pattern *hc_sparse_compile(const unsigned char *x, int m, hc_scratch *s) {
+    if (m < HC_Q) return NULL;  // have to be at least Q in length to search.
+
+    // Build the dense table in the scratch area.
+    hc_scratch_clear(s);
+    unsigned int *B = s->p->B;
+    const unsigned int Hm = hc_link_qgrams(x, m, B);
+
+    // Take the non-zero entries, zeroing each one as it is taken, so none is taken twice and the table is left clean.
+    hc_sparse_entry *entries = malloc((m - HC_END_FIRST_QGRAM) * sizeof(hc_sparse_entry));
+    int nentries = 0;
+    for (int pos = HC_END_FIRST_QGRAM; pos < m; pos++) {
+        const unsigned int bucket = hc_chain_hash(x, pos) & HC_TABLE_MASK;
+        if (B[bucket]) {
+            if (entries) {
+                entries[nentries].bucket = bucket;
+                entries[nentries].bits = B[bucket];
+                nentries++;
+            }
+            B[bucket] = 0;
+        }
+    }
+    if (!entries) return NULL;
+    qsort(entries, nentries, sizeof(hc_sparse_entry), hc_sparse_entry_cmp);
+
+    hc_sparse_pattern *sp = malloc(sizeof(hc_sparse_pattern) + nentries * (sizeof(unsigned int) + sizeof(hc_text_hash)) + m);
+    if (sp) {
+        sp->m = m;
+        sp->nentries = nentries;
+        sp->Hm = Hm;
+        hc_text_hash *buckets = hc_sparse_buckets(sp);
+        for (int i = 0; i < nentries; i++) {
+            sp->bits[i] = entries[i].bits;
+            buckets[i] = (hc_text_hash) entries[i].bucket;
+        }
+        memcpy(hc_sparse_x(sp), x, m);
+    }
+    free(entries);
+    return sp;
+}
+
+void hc_sparse_free(hc_sparse_pattern *sp) {
+    free(sp);
+}
+
+size_t hc_sparse_size(const hc_sparse_pattern *sp) {
+    return sizeof(hc_sparse_pattern) + sp->nentries * (sizeof(unsigned int) + sizeof(hc_text_hash)) + sp->m;
+}
+
+const hc_pattern *hc_sparse_expand(const hc_sparse_pattern *sp, hc_scratch *s) {
+    hc_scratch_clear(s);
+    if (hc_scratch_reserve(s, sp->m)) return NULL;
+
+    hc_pattern *p = s->p;
+    const hc_text_hash *buckets = hc_sparse_buckets(sp);
+    for (int i = 0; i < sp->nentries; i++) {
+        p->B[buckets[i]] = sp->bits[i];
+    }
+    memcpy((unsigned char *) p->x, hc_sparse_x(sp), sp->m);
+    hc_pre_kmp(p->x, sp->m, (int *) p->kmp);
+    p->m = sp->m;
+    p->Hm = sp->Hm;
+    return p;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Compact storage of compiled patterns, for very large pattern sets.
+ *
+ * A compiled hc_pattern holds a dense table of HC_ASIZE entries, but a short pattern only sets a few of them.
+ * A sparse pattern stores just the non-zero entries, as a list of (bucket, bits) pairs sorted by bucket, and a copy
+ * of the pattern.  To search for it, it is expanded into a dense hc_pattern in a reusable scratch area, which only
+ * has to clear the entries of the pattern expanded into it before, so huge pattern sets fit in memory and only
+ * the patterns being searched for pay for a dense table.
+ */
+
+#ifndef HC_SPARSE_H
+#define HC_SPARSE_H
+
+#include <stddef.h>
+#include "hashchain.h"
+
+/*
+ * A compiled pattern at rest.  Never modified after hc_sparse_compile() returns, so it can be shared between threads.
+ * The bits of each entry are stored first, followed by the buckets they go in, then the pattern.
+ */
+typedef struct hc_sparse_pattern {
+    int m;                      // Length of the pattern.
+    int nentries;               // Number of non-zero entries in the table.
+    unsigned int Hm;            // Hash value of the first q-gram, as in hc_pattern.
+    unsigned int bits[];        // The non-zero entries, in bucket order.
+} hc_sparse_pattern;
+
+/*
+ * A scratch area which holds one dense pattern at a time.  It belongs to one thread, and is reused for each pattern
+ * expanded into it.  Its table is only ever touched at the entries of the pattern it currently holds.
+ */
+typedef struct hc_scratch {
+    hc_pattern *p;              // The dense pattern, with m == 0 if it holds none.
+    int max_m;                  // The longest pattern it has room for.
+} hc_scratch;
+
+/*
+ * Creates and destroys a scratch area.  Returns NULL if memory cannot be allocated.
+ */
+hc_scratch *hc_scratch_create(void);
+void hc_scratch_destroy(hc_scratch *s);
+
+/*
+ * Compiles a pattern x of length m into sparse form, using the scratch area for the dense table while it is built.
+ * Anything expanded into the scratch area is lost.  Returns NULL if the pattern is shorter than HC_Q or memory
+ * cannot be allocated.
+ */
+hc_sparse_pattern *hc_sparse_compile(const unsigned char *x, int m, hc_scratch *s);
+
+/*
+ * Frees a sparse pattern.
+ */
+void hc_sparse_free(hc_sparse_pattern *sp);
+
+/*
+ * Returns the number of bytes a sparse pattern takes.
+ */
+size_t hc_sparse_size(const hc_sparse_pattern *sp);
+
+/*
+ * Expands a sparse pattern into the scratch area, replacing the pattern it held, and returns the dense pattern,
+ * which can be searched for with any of the hc_search functions until the scratch area is next used.  It costs
+ * time in proportion to the lengths of the two patterns, not the size of the table.  Returns NULL if memory cannot
+ * be allocated.
+ */
+const hc_pattern *hc_sparse_expand(const hc_sparse_pattern *sp, hc_scratch *s);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Incremental search of append-only files.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "hc_tail.h"
+
+/*
+ * Translates positions in the buffer into file offsets for the caller's match function.
+ */
+typedef struct hc_tail_match {
+    hc_tail_match_fn *on_match;
+    void *data;
+    int pattern;
+    long base;                  // File offset of the start of the text being searched.
+    int stopped;                // Set if on_match asked to stop.
+} hc_tail_match;
+
+static int hc_tail_report(void *data, long pos) {
+    hc_tail_match *match = data;
+    return match->stopped = match->on_match(match->data, match->pattern, match->base + pos);
+}
+
+hc_tail *hc_tail_create(int fd, const hc_pattern *const *patterns, int npatterns, long offset) {
+    int max_m = 1;
+    for (int i = 0; i < npatterns; i++) if (patterns[i]->m > max_m) max_m = patterns[i]->m;
+
+    hc_tail *t = malloc(sizeof(hc_tail));
+    if (!t) return NULL;
+    t->buffer = malloc(max_m - 1 + HC_TAIL_CHUNK);
+    if (!t->buffer) {
+        free(t);
+        return NULL;
+    }
+    t->fd = fd;
+    t->patterns = patterns;
+    t->npatterns = npatterns;
+    t->overlap = max_m - 1;
+    t->offset = offset;
+    t->kept = 0;
+    return t;
+}
+
+void hc_tail_free(hc_tail *t) {
+    free(t->buffer);
+    free(t);
+}
+
+long hc_tail_poll(hc_tail *t, hc_tail_match_fn *on_match, void *data) {
+    struct stat st;
+    if (fstat(t->fd, &st) < 0) return -1;
+
+    // If the file was truncated or replaced by a shorter one, start again from the beginning.
+    if (st.st_size < t->offset) {
+        t->offset = 0;
+        t->kept = 0;
+    }
+
+    long count = 0;
+    while (t->offset < st.st_size) {
+
+        // Read the next chunk of appended bytes after the kept bytes.
+        ssize_t got = pread(t->fd, t->buffer + t->kept, HC_TAIL_CHUNK, t->offset);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (got == 0) break;
+        const long len = t->kept + got;
+
+        // Search only the windows which end in the new bytes: those ending in the kept bytes were found before.
+        int stopped = 0;
+        for (int i = 0; i < t->npatterns && !stopped; i++) {
+            const hc_pattern *p = t->patterns[i];
+            const long start = t->kept > p->m - 1 ? t->kept - (p->m - 1) : 0;
+            hc_tail_match match = { on_match, data, i, t->offset - t->kept + start, 0 };
+            hc_context ctx = { on_match ? hc_tail_report : NULL, &match, 0, 0, 0, NULL };
+            count += hc_search(p, t->buffer + start, len - start, &ctx);
+            stopped = match.stopped;
+        }
+        t->offset += got;
+
+        // Keep the last bytes for windows which span this chunk and the next.
+        const int keep = len < t->overlap ? (int) len : t->overlap;
+        memmove(t->buffer, t->buffer + len - keep, keep);
+        t->kept = keep;
+        if (stopped) break;
+    }
+    return count;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2022 Matt Palmer.  All rights reserved.
+ *
+ * Incremental search of append-only files, such as logs which are being written to.
+ *
+ * A tail handle remembers how far it has searched a file for a set of patterns, and keeps the last bytes it read,
+ * one less than the longest pattern.  Each poll reads only the bytes appended since the last one with pread(),
+ * and searches them together with the kept bytes, so matches spanning two polls are found exactly once.
+ */
+
+#ifndef HC_TAIL_H
+#define HC_TAIL_H
+
+#include "hashchain.h"
+
+/*
+ * The number of bytes read from the file at a time.
+ */
+#ifndef HC_TAIL_CHUNK
+#define HC_TAIL_CHUNK (1 << 20)
+#endif
+
+/*
+ * Called for each match of pattern number pattern, found at offset in the file.  Return non-zero to stop the poll;
+ * the matches not yet reported in the bytes already read are then lost.
+ */
+typedef int hc_tail_match_fn(void *data, int pattern, long offset);
+
+typedef struct hc_tail {
+    int fd;                             // The file being searched, owned by the caller.
+    const hc_pattern *const *patterns;  // The patterns searched for, owned by the caller.
+    int npatterns;
+    int overlap;                        // One less than the length of the longest pattern.
+    long offset;                        // Offset in the file up to which it has been searched.
+    int kept;                           // Number of bytes before offset kept at the start of the buffer.
+    unsigned char *buffer;              // overlap + HC_TAIL_CHUNK bytes.
+} hc_tail;
+
+/*
+ * Creates a tail handle to search an open file fd for npatterns compiled patterns, starting at offset.
+ * Returns NULL if memory cannot be allocated.
+ */
+hc_tail *hc_tail_create(int fd, const hc_pattern *const *patterns, int npatterns, long offset);
+
+/*
+ * Frees a tail handle.  The file is not closed.
+ */
+void hc_tail_free(hc_tail *t);
+
+/*
+ * Searches the bytes appended to the file since the last poll, calling on_match for each match.
+ * If the file has been truncated below the offset already searched, searching restarts from the beginning.
+ * Returns the number of matches found, or -1 if the file could not be read.
+ */
+long hc_tail_poll(hc_tail *t, hc_tail_match_fn *on_match, void *data);
+
+#endif